@@ -2,10 +2,49 @@
 #define CHACHA20_H
 
 #include <iomanip>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "chacha20_simd.h"
+#include "../THREADPOOL/thread_pool.h"
 
 class ChaCha20 {
 public:
+    // Реализации генерации ключевого потока: скалярная и векторные на 4, 8 и 16 блоков
+    enum Backend {
+        SCALAR = 0, SSE2 = 1, AVX2 = 2, AVX512 = 3
+    };
+
     static void encrypt(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len);
+    // Эталонная реализация по одному блоку, всегда без SIMD
+    static void encrypt_scalar(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len);
+
+    // То же, что encrypt (и расшифрование), но большой буфер режется по диапазонам счетчика
+    // и обрабатывается общим пулом потоков; короткие сообщения остаются в вызывающем потоке
+    static void encrypt_parallel(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len);
+    static size_t parallel_threshold();
+    static void set_parallel_threshold(size_t bytes);
+
+    static Backend backend();
+    static bool set_backend(Backend b);
+
+    // Потоковый контекст: ключ и nonce разбираются один раз, шифрование можно вести кусками
+    // произвольной длины и переходить к любому смещению потока через 32-битный счетчик блоков
+    class Context {
+    public:
+        Context(const uint8_t* key_bytes, const uint8_t* nonce_bytes, uint32_t counter = 1);
+
+        void update(uint8_t* output, const uint8_t* input, size_t len);
+        void seek(uint64_t offset);
+        uint64_t tell() const;
+
+    private:
+        uint32_t state[16];     // state[12] - счетчик следующего еще не сгенерированного блока
+        uint32_t initial_counter;
+        uint8_t keystream[64];  // остаток текущего блока ключевого потока
+        size_t used;            // сколько байт keystream уже израсходовано (64 - буфер пуст)
+    };
 
 private:
     static uint32_t left_rotate(uint32_t value, size_t n);
@@ -14,13 +53,43 @@ private:
     static void chacha20_block(const uint32_t* key, uint32_t counter, const uint32_t* nonce, uint32_t* output);
     static void serialize(const uint32_t* state_array, uint8_t* output);
     static void bytes_to_uint32_array(const uint8_t* data, uint32_t* output, size_t length);
+    static void init_state(uint32_t* state, const uint8_t* key_bytes, const uint8_t* nonce_bytes, uint32_t counter);
+    static void xor_blocks(uint32_t* state, uint8_t* output, const uint8_t* input, size_t blocks, Backend b);
+    static void encrypt_with(Backend b, uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len);
+    static Backend detect_backend();
 
     static const uint32_t CONSTANTS[4];
+    static Backend active_backend;
+    static size_t min_parallel_len;
 };
 
-#endif // CHACHA20_H
-
 const uint32_t ChaCha20::CONSTANTS[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+ChaCha20::Backend ChaCha20::active_backend = ChaCha20::detect_backend();
+size_t ChaCha20::min_parallel_len = 256 * 1024;
+
+// Выбирает самое широкое ядро, которое поддерживает процессор
+ChaCha20::Backend ChaCha20::detect_backend() {
+#if CHACHA20_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return AVX512;
+    if (__builtin_cpu_supports("avx2")) return AVX2;
+    if (__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+    return SCALAR;
+}
+
+ChaCha20::Backend ChaCha20::backend() {
+    return active_backend;
+}
+
+// Принудительный выбор реализации (для тестов и замеров); нельзя выбрать ядро шире доступного
+bool ChaCha20::set_backend(Backend b) {
+    if (b > detect_backend()) {
+        return false;
+    }
+    active_backend = b;
+    return true;
+}
 
 uint32_t ChaCha20::left_rotate(uint32_t value, size_t n) {
     n %= 32;
@@ -90,41 +159,166 @@ void ChaCha20::bytes_to_uint32_array(const uint8_t* data, uint32_t* output, size
     }
 }
 
-void ChaCha20::encrypt(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len) {
-    
-    uint32_t key[8];
-    uint32_t nonce[3];
-
-    uint8_t counter = 1;
-
-    bytes_to_uint32_array(key_bytes, key, 32);
-    bytes_to_uint32_array(nonce_bytes, nonce, 12);
-    
-    // uint8_t* ciphertext = new uint8_t[len];
-    for (int j = 0; j < floor(len/64); ++j) {
+// XOR целых блоков с ключевым потоком начиная со счетчика state[12]; счетчик сдвигается на число блоков.
+// Сначала работают широкие ядра, остаток дожимается более узкими и скалярным кодом.
+void ChaCha20::xor_blocks(uint32_t* state, uint8_t* output, const uint8_t* input, size_t blocks, Backend b) {
+#if CHACHA20_X86
+    if (b >= AVX512) {
+        for (; blocks >= 16; blocks -= 16, state[12] += 16, input += 16 * 64, output += 16 * 64) {
+            chacha20_blocks_avx512(state, output, input);
+        }
+    }
+    if (b >= AVX2) {
+        for (; blocks >= 8; blocks -= 8, state[12] += 8, input += 8 * 64, output += 8 * 64) {
+            chacha20_blocks_avx2(state, output, input);
+        }
+    }
+    if (b >= SSE2) {
+        for (; blocks >= 4; blocks -= 4, state[12] += 4, input += 4 * 64, output += 4 * 64) {
+            chacha20_blocks_sse2(state, output, input);
+        }
+    }
+#endif
+    for (; blocks > 0; --blocks, ++state[12], input += 64, output += 64) {
         uint32_t block_output[16];
         uint8_t keystream[64];
-        chacha20_block(key, counter+j, nonce, block_output);
+        chacha20_block(state + 4, state[12], state + 13, block_output);
         serialize(block_output, keystream);
 
-        const uint8_t* block = plaintext + j * 64;
         for (size_t i = 0; i < 64; ++i) {
-            output[i+j*64] = block[i] ^ keystream[i];
+            output[i] = input[i] ^ keystream[i];
         }
     }
+}
+
+// Состояние в том же порядке, что и в chacha20_block: константы, ключ, счетчик, nonce
+void ChaCha20::init_state(uint32_t* state, const uint8_t* key_bytes, const uint8_t* nonce_bytes, uint32_t counter) {
+    for (int i = 0; i < 4; i++) {
+        state[i] = CONSTANTS[i];
+    }
+    bytes_to_uint32_array(key_bytes, state + 4, 32);
+    state[12] = counter;
+    bytes_to_uint32_array(nonce_bytes, state + 13, 12);
+}
+
+void ChaCha20::encrypt_with(Backend b, uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len) {
+
+    uint32_t state[16];
+    init_state(state, key_bytes, nonce_bytes, 1);
+
+    size_t full = len / 64;
+    xor_blocks(state, output, plaintext, full, b);
 
     if (len % 64 != 0) {
         uint32_t block_output[16];
         uint8_t keystream[64];
-        chacha20_block(key, counter + (len / 64), nonce, block_output);
+        chacha20_block(state + 4, state[12], state + 13, block_output);
         serialize(block_output, keystream);
-        const uint8_t* block = plaintext + (len / 64) * 64;
+        const uint8_t* block = plaintext + full * 64;
         for (size_t i = 0; i < len % 64; i++) {
-            output[i + (len / 64) * 64] = block[i] ^ keystream[i];
+            output[i + full * 64] = block[i] ^ keystream[i];
+        }
+    }
+}
+
+void ChaCha20::encrypt(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len) {
+    Context ctx(key_bytes, nonce_bytes);
+    ctx.update(output, plaintext, len);
+}
+
+void ChaCha20::encrypt_scalar(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len) {
+    encrypt_with(SCALAR, output, key_bytes, nonce_bytes, plaintext, len);
+}
+
+size_t ChaCha20::parallel_threshold() {
+    return min_parallel_len;
+}
+
+// Минимальный размер буфера, начиная с которого работа раздается пулу потоков
+void ChaCha20::set_parallel_threshold(size_t bytes) {
+    min_parallel_len = bytes;
+}
+
+void ChaCha20::encrypt_parallel(uint8_t* output, const uint8_t* key_bytes, const uint8_t* nonce_bytes, const uint8_t* plaintext, size_t len) {
+    ThreadPool& pool = ThreadPool::instance();
+    if (len < min_parallel_len || pool.size() < 2) {
+        encrypt(output, key_bytes, nonce_bytes, plaintext, len);
+        return;
+    }
+
+    // По несколько кусков на поток, чтобы выровнять нагрузку; границы кратны 16 блокам,
+    // так что каждый кусок целиком идет через самое широкое ядро
+    const size_t granule = 16 * 64;
+    size_t chunks = pool.size() * 4;
+    size_t chunk_len = (len / chunks + granule - 1) / granule * granule;
+    if (chunk_len < granule) chunk_len = granule;
+    chunks = (len + chunk_len - 1) / chunk_len;
+
+    pool.parallel_for(chunks, [&](size_t i) {
+        size_t offset = i * chunk_len;
+        size_t part = std::min(chunk_len, len - offset);
+
+        Context ctx(key_bytes, nonce_bytes);
+        ctx.seek(offset);
+        ctx.update(output + offset, plaintext + offset, part);
+    });
+}
+
+ChaCha20::Context::Context(const uint8_t* key_bytes, const uint8_t* nonce_bytes, uint32_t counter)
+    : initial_counter(counter), used(64) {
+    init_state(state, key_bytes, nonce_bytes, counter);
+}
+
+// Шифрует очередной кусок потока: сначала добирает остаток буферизованного блока,
+// затем целые блоки идут через векторные ядра, хвост оставляется в keystream для следующего вызова
+void ChaCha20::Context::update(uint8_t* output, const uint8_t* input, size_t len) {
+    while (used < 64 && len > 0) {
+        *output++ = *input++ ^ keystream[used++];
+        --len;
+    }
+
+    size_t blocks = len / 64;
+    xor_blocks(state, output, input, blocks, active_backend);
+    output += blocks * 64;
+    input += blocks * 64;
+    len %= 64;
+
+    if (len > 0) {
+        uint32_t block_output[16];
+        chacha20_block(state + 4, state[12], state + 13, block_output);
+        serialize(block_output, keystream);
+        ++state[12];
+
+        for (used = 0; used < len; ++used) {
+            output[used] = input[used] ^ keystream[used];
         }
     }
 }
 
+// Переход к байтовому смещению offset от начала потока (от начального счетчика)
+void ChaCha20::Context::seek(uint64_t offset) {
+    uint64_t block = offset / 64;
+    if (block + initial_counter > 0xFFFFFFFFull) {
+        throw std::runtime_error("ChaCha20 offset exceeds the 32-bit block counter.");
+    }
+
+    state[12] = static_cast<uint32_t>(initial_counter + block);
+    used = 64;
+
+    if (offset % 64 != 0) {
+        uint32_t block_output[16];
+        chacha20_block(state + 4, state[12], state + 13, block_output);
+        serialize(block_output, keystream);
+        ++state[12];
+        used = offset % 64;
+    }
+}
+
+uint64_t ChaCha20::Context::tell() const {
+    uint64_t next_block = static_cast<uint64_t>(state[12] - initial_counter);
+    return used < 64 ? (next_block - 1) * 64 + used : next_block * 64;
+}
+
 // int main() {
 
 //     uint8_t key[32] = {
@@ -166,3 +360,5 @@ void ChaCha20::encrypt(uint8_t* output, const uint8_t* key_bytes, const uint8_t*
 
 //     return 0;
 // }
+
+#endif // CHACHA20_H
@@ -0,0 +1,217 @@
+#ifndef CHACHA20_SIMD_H
+#define CHACHA20_SIMD_H
+
+// Векторные ядра ChaCha20: каждое считает сразу несколько 64-байтовых блоков.
+// Слово i состояния всех блоков лежит в одном векторе, блоки отличаются только счетчиком (слово 12),
+// поэтому раунды идут "поперек" блоков, а перед записью результат транспонируется обратно в блоки.
+// Ядра собираются через target-атрибуты, поэтому не требуют -mavx2/-mavx512f при компиляции,
+// а выбор нужного делается во время выполнения (см. ChaCha20::detect_backend).
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHACHA20_X86 1
+#include <immintrin.h>
+#else
+#define CHACHA20_X86 0
+#endif
+
+#if CHACHA20_X86
+
+#define CHACHA20_TARGET(isa) __attribute__((target(isa)))
+
+// 4 блока за вызов: state - исходное состояние (16 слов), блоки используют счетчики state[12] .. state[12] + 3
+CHACHA20_TARGET("sse2")
+static void chacha20_blocks_sse2(const uint32_t* state, uint8_t* out, const uint8_t* in) {
+    __m128i x[16];
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+    }
+    const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    x[12] = _mm_add_epi32(x[12], lanes);
+
+#define ROTL128(v, n) _mm_or_si128(_mm_slli_epi32((v), (n)), _mm_srli_epi32((v), 32 - (n)))
+#define QR128(a, b, c, d) \
+    x[a] = _mm_add_epi32(x[a], x[b]); x[d] = _mm_xor_si128(x[d], x[a]); x[d] = ROTL128(x[d], 16); \
+    x[c] = _mm_add_epi32(x[c], x[d]); x[b] = _mm_xor_si128(x[b], x[c]); x[b] = ROTL128(x[b], 12); \
+    x[a] = _mm_add_epi32(x[a], x[b]); x[d] = _mm_xor_si128(x[d], x[a]); x[d] = ROTL128(x[d], 8);  \
+    x[c] = _mm_add_epi32(x[c], x[d]); x[b] = _mm_xor_si128(x[b], x[c]); x[b] = ROTL128(x[b], 7);
+
+    for (int r = 0; r < 10; ++r) {
+        QR128(0, 4, 8, 12) QR128(1, 5, 9, 13) QR128(2, 6, 10, 14) QR128(3, 7, 11, 15)
+        QR128(0, 5, 10, 15) QR128(1, 6, 11, 12) QR128(2, 7, 8, 13) QR128(3, 4, 9, 14)
+    }
+
+#undef QR128
+#undef ROTL128
+
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm_add_epi32(x[i], _mm_set1_epi32(static_cast<int>(state[i])));
+    }
+    x[12] = _mm_add_epi32(x[12], lanes);
+
+    // Транспонируем каждую четверку слов 4x4: после этого blk[j] - слова 4g..4g+3 блока j
+    for (int g = 0; g < 4; ++g) {
+        __m128i t0 = _mm_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+        __m128i t1 = _mm_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+        __m128i t2 = _mm_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+        __m128i t3 = _mm_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+
+        __m128i blk[4] = {
+            _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+            _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+        };
+
+        for (int j = 0; j < 4; ++j) {
+            size_t off = j * 64 + g * 16;
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + off));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + off), _mm_xor_si128(m, blk[j]));
+        }
+    }
+}
+
+// 8 блоков за вызов, счетчики state[12] .. state[12] + 7
+CHACHA20_TARGET("avx2")
+static void chacha20_blocks_avx2(const uint32_t* state, uint8_t* out, const uint8_t* in) {
+    __m256i x[16];
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+    }
+    const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    x[12] = _mm256_add_epi32(x[12], lanes);
+
+    // Повороты на 16 и 8 бит - это перестановка байтов внутри слова
+    const __m256i rot16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                          13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i rot8 = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                         14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+#define ROTL256(v, n) _mm256_or_si256(_mm256_slli_epi32((v), (n)), _mm256_srli_epi32((v), 32 - (n)))
+#define QR256(a, b, c, d) \
+    x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = _mm256_xor_si256(x[d], x[a]); x[d] = _mm256_shuffle_epi8(x[d], rot16); \
+    x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = _mm256_xor_si256(x[b], x[c]); x[b] = ROTL256(x[b], 12);                \
+    x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = _mm256_xor_si256(x[d], x[a]); x[d] = _mm256_shuffle_epi8(x[d], rot8);  \
+    x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = _mm256_xor_si256(x[b], x[c]); x[b] = ROTL256(x[b], 7);
+
+    for (int r = 0; r < 10; ++r) {
+        QR256(0, 4, 8, 12) QR256(1, 5, 9, 13) QR256(2, 6, 10, 14) QR256(3, 7, 11, 15)
+        QR256(0, 5, 10, 15) QR256(1, 6, 11, 12) QR256(2, 7, 8, 13) QR256(3, 4, 9, 14)
+    }
+
+#undef QR256
+#undef ROTL256
+
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm256_add_epi32(x[i], _mm256_set1_epi32(static_cast<int>(state[i])));
+    }
+    x[12] = _mm256_add_epi32(x[12], lanes);
+
+    // Транспонирование 4x4 внутри 128-битных половин: blk[g][j] содержит слова 4g..4g+3
+    // блока j (младшая половина) и блока j + 4 (старшая половина)
+    __m256i blk[4][4];
+    for (int g = 0; g < 4; ++g) {
+        __m256i t0 = _mm256_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+        __m256i t1 = _mm256_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+        __m256i t2 = _mm256_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+        __m256i t3 = _mm256_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+
+        blk[g][0] = _mm256_unpacklo_epi64(t0, t1);
+        blk[g][1] = _mm256_unpackhi_epi64(t0, t1);
+        blk[g][2] = _mm256_unpacklo_epi64(t2, t3);
+        blk[g][3] = _mm256_unpackhi_epi64(t2, t3);
+    }
+
+    for (int j = 0; j < 4; ++j) {
+        __m256i out_blocks[4] = {
+            _mm256_permute2x128_si256(blk[0][j], blk[1][j], 0x20), // блок j, слова 0..7
+            _mm256_permute2x128_si256(blk[2][j], blk[3][j], 0x20), // блок j, слова 8..15
+            _mm256_permute2x128_si256(blk[0][j], blk[1][j], 0x31), // блок j + 4, слова 0..7
+            _mm256_permute2x128_si256(blk[2][j], blk[3][j], 0x31)  // блок j + 4, слова 8..15
+        };
+        size_t offs[4] = { j * 64u, j * 64u + 32, (j + 4) * 64u, (j + 4) * 64u + 32 };
+
+        for (int q = 0; q < 4; ++q) {
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + offs[q]));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + offs[q]), _mm256_xor_si256(m, out_blocks[q]));
+        }
+    }
+}
+
+// GCC 12 ругается на _mm512_undefined_* внутри собственных интринсиков AVX-512 (ложное срабатывание)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// 16 блоков за вызов, счетчики state[12] .. state[12] + 15
+CHACHA20_TARGET("avx512f")
+static void chacha20_blocks_avx512(const uint32_t* state, uint8_t* out, const uint8_t* in) {
+    __m512i x[16];
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm512_set1_epi32(static_cast<int>(state[i]));
+    }
+    const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    x[12] = _mm512_add_epi32(x[12], lanes);
+
+#define QR512(a, b, c, d) \
+    x[a] = _mm512_add_epi32(x[a], x[b]); x[d] = _mm512_xor_si512(x[d], x[a]); x[d] = _mm512_rol_epi32(x[d], 16); \
+    x[c] = _mm512_add_epi32(x[c], x[d]); x[b] = _mm512_xor_si512(x[b], x[c]); x[b] = _mm512_rol_epi32(x[b], 12); \
+    x[a] = _mm512_add_epi32(x[a], x[b]); x[d] = _mm512_xor_si512(x[d], x[a]); x[d] = _mm512_rol_epi32(x[d], 8);  \
+    x[c] = _mm512_add_epi32(x[c], x[d]); x[b] = _mm512_xor_si512(x[b], x[c]); x[b] = _mm512_rol_epi32(x[b], 7);
+
+    for (int r = 0; r < 10; ++r) {
+        QR512(0, 4, 8, 12) QR512(1, 5, 9, 13) QR512(2, 6, 10, 14) QR512(3, 7, 11, 15)
+        QR512(0, 5, 10, 15) QR512(1, 6, 11, 12) QR512(2, 7, 8, 13) QR512(3, 4, 9, 14)
+    }
+
+#undef QR512
+
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm512_add_epi32(x[i], _mm512_set1_epi32(static_cast<int>(state[i])));
+    }
+    x[12] = _mm512_add_epi32(x[12], lanes);
+
+    // После транспонирования 4x4 внутри 128-битных четвертей blk[g][j] содержит
+    // слова 4g..4g+3 блоков j, j + 4, j + 8, j + 12
+    __m512i blk[4][4];
+    for (int g = 0; g < 4; ++g) {
+        __m512i t0 = _mm512_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+        __m512i t1 = _mm512_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+        __m512i t2 = _mm512_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+        __m512i t3 = _mm512_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+
+        blk[g][0] = _mm512_unpacklo_epi64(t0, t1);
+        blk[g][1] = _mm512_unpackhi_epi64(t0, t1);
+        blk[g][2] = _mm512_unpacklo_epi64(t2, t3);
+        blk[g][3] = _mm512_unpackhi_epi64(t2, t3);
+    }
+
+    // Оставшееся транспонирование 4x4 уже из 128-битных четвертей собирает целые блоки
+    for (int j = 0; j < 4; ++j) {
+        __m512i ab_lo = _mm512_shuffle_i32x4(blk[0][j], blk[1][j], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i ab_hi = _mm512_shuffle_i32x4(blk[0][j], blk[1][j], _MM_SHUFFLE(3, 2, 3, 2));
+        __m512i cd_lo = _mm512_shuffle_i32x4(blk[2][j], blk[3][j], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i cd_hi = _mm512_shuffle_i32x4(blk[2][j], blk[3][j], _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m512i out_blocks[4] = {
+            _mm512_shuffle_i32x4(ab_lo, cd_lo, _MM_SHUFFLE(2, 0, 2, 0)), // блок j
+            _mm512_shuffle_i32x4(ab_lo, cd_lo, _MM_SHUFFLE(3, 1, 3, 1)), // блок j + 4
+            _mm512_shuffle_i32x4(ab_hi, cd_hi, _MM_SHUFFLE(2, 0, 2, 0)), // блок j + 8
+            _mm512_shuffle_i32x4(ab_hi, cd_hi, _MM_SHUFFLE(3, 1, 3, 1))  // блок j + 12
+        };
+
+        for (int q = 0; q < 4; ++q) {
+            size_t off = (j + 4 * q) * 64;
+            __m512i m = _mm512_loadu_si512(in + off);
+            _mm512_storeu_si512(out + off, _mm512_xor_si512(m, out_blocks[q]));
+        }
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#undef CHACHA20_TARGET
+
+#endif // CHACHA20_X86
+
+#endif // CHACHA20_SIMD_H
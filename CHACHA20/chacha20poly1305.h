@@ -0,0 +1,201 @@
+#ifndef CHACHA20POLY1305_H
+#define CHACHA20POLY1305_H
+
+#include <sys/uio.h>
+
+#include "chacha20.h"
+#include "../POLY1305/poly1305.h"
+
+// AEAD ChaCha20-Poly1305 (RFC 8439) поверх ChaCha20::Context.
+// Шифрование и MAC идут одним проходом: данные режутся на куски по FUSED_CHUNK байт,
+// и каждый кусок сразу после шифрования (или перед расшифрованием) подается в Poly1305,
+// пока он еще лежит в L1. Ключ Poly1305 - первые 32 байта блока со счетчиком 0.
+class ChaCha20Poly1305 {
+public:
+    static const size_t TAG_LEN = Poly1305::TAG_LEN;
+    static const size_t FUSED_CHUNK = 2048;
+
+    ChaCha20Poly1305(const uint8_t* key, const uint8_t* nonce);
+
+    // Дополнительные аутентифицируемые данные подаются до шифруемых
+    void aad(const uint8_t* data, size_t len);
+    void encrypt(uint8_t* output, const uint8_t* input, size_t len);
+    void decrypt(uint8_t* output, const uint8_t* input, size_t len);
+    void finish(uint8_t* tag);
+    bool verify(const uint8_t* tag);
+
+    static void seal(uint8_t* output, uint8_t* tag, const uint8_t* key, const uint8_t* nonce,
+                     const uint8_t* aad, size_t aad_len, const uint8_t* plaintext, size_t len);
+    static bool open(uint8_t* output, const uint8_t* key, const uint8_t* nonce,
+                     const uint8_t* aad, size_t aad_len, const uint8_t* ciphertext, size_t len, const uint8_t* tag);
+
+    // seal по заранее посчитанному потоку этого nonce: keystream - блоки 0, 1, 2, ...
+    // (первые 32 байта - ключ Poly1305, данные шифруются потоком с байта 64), длина не меньше 64 + len
+    static void seal_precomputed(uint8_t* output, uint8_t* tag, const uint8_t* keystream,
+                                 const uint8_t* aad, size_t aad_len, const uint8_t* plaintext, size_t len);
+    // То же для открытого текста из нескольких кусков: шифртекст пишется в output подряд.
+    // Куски не должны пересекаться с output, кроме шифрования точно на месте.
+    static void seal_precomputed(uint8_t* output, uint8_t* tag, const uint8_t* keystream,
+                                 const uint8_t* aad, size_t aad_len, const struct iovec* parts, size_t count);
+
+private:
+    static Poly1305 make_mac(const uint8_t* key, const uint8_t* nonce);
+    static void pad16(Poly1305& mac);
+    static void finish_mac(Poly1305& mac, uint64_t aad_len, uint64_t text_len, uint8_t* tag);
+
+    ChaCha20::Context stream;
+    Poly1305 mac;
+    uint64_t aad_len;
+    uint64_t text_len;
+    bool aad_closed;
+};
+
+Poly1305 ChaCha20Poly1305::make_mac(const uint8_t* key, const uint8_t* nonce) {
+    uint8_t block0[64] = {0};
+    ChaCha20::Context otk(key, nonce, 0);
+    otk.update(block0, block0, sizeof(block0));
+
+    Poly1305 p(block0);
+    volatile uint8_t* wipe = block0;
+    for (size_t i = 0; i < sizeof(block0); ++i) wipe[i] = 0;
+    return p;
+}
+
+ChaCha20Poly1305::ChaCha20Poly1305(const uint8_t* key, const uint8_t* nonce)
+    : stream(key, nonce, 1), mac(make_mac(key, nonce)), aad_len(0), text_len(0), aad_closed(false) {
+}
+
+void ChaCha20Poly1305::pad16(Poly1305& mac) {
+    static const uint8_t zeros[16] = {0};
+    size_t rem = mac.length() % 16;
+    if (rem != 0) {
+        mac.update(zeros, 16 - rem);
+    }
+}
+
+void ChaCha20Poly1305::aad(const uint8_t* data, size_t len) {
+    if (aad_closed) {
+        throw std::runtime_error("AAD must be supplied before the payload.");
+    }
+    mac.update(data, len);
+    aad_len += len;
+}
+
+void ChaCha20Poly1305::encrypt(uint8_t* output, const uint8_t* input, size_t len) {
+    if (!aad_closed) {
+        pad16(mac);
+        aad_closed = true;
+    }
+    text_len += len;
+
+    while (len > 0) {
+        size_t part = len < FUSED_CHUNK ? len : FUSED_CHUNK;
+        stream.update(output, input, part);
+        mac.update(output, part);
+        output += part;
+        input += part;
+        len -= part;
+    }
+}
+
+// Для расшифрования MAC считается по шифртексту до XOR, поэтому работает и на месте (output == input)
+void ChaCha20Poly1305::decrypt(uint8_t* output, const uint8_t* input, size_t len) {
+    if (!aad_closed) {
+        pad16(mac);
+        aad_closed = true;
+    }
+    text_len += len;
+
+    while (len > 0) {
+        size_t part = len < FUSED_CHUNK ? len : FUSED_CHUNK;
+        mac.update(input, part);
+        stream.update(output, input, part);
+        output += part;
+        input += part;
+        len -= part;
+    }
+}
+
+// Хвост MAC по RFC 8439: выравнивание шифртекста и длины AAD и шифртекста (little-endian)
+void ChaCha20Poly1305::finish_mac(Poly1305& mac, uint64_t aad_len, uint64_t text_len, uint8_t* tag) {
+    pad16(mac);
+
+    uint8_t lengths[16];
+    for (int i = 0; i < 8; ++i) {
+        lengths[i] = static_cast<uint8_t>(aad_len >> (8 * i));
+        lengths[8 + i] = static_cast<uint8_t>(text_len >> (8 * i));
+    }
+    mac.update(lengths, sizeof(lengths));
+    mac.finish(tag);
+}
+
+void ChaCha20Poly1305::finish(uint8_t* tag) {
+    if (!aad_closed) {
+        pad16(mac);
+        aad_closed = true;
+    }
+    finish_mac(mac, aad_len, text_len, tag);
+}
+
+bool ChaCha20Poly1305::verify(const uint8_t* tag) {
+    uint8_t expected[TAG_LEN];
+    finish(expected);
+    return Poly1305::verify(expected, tag);
+}
+
+void ChaCha20Poly1305::seal(uint8_t* output, uint8_t* tag, const uint8_t* key, const uint8_t* nonce,
+                            const uint8_t* aad, size_t aad_len, const uint8_t* plaintext, size_t len) {
+    ChaCha20Poly1305 aead(key, nonce);
+    aead.aad(aad, aad_len);
+    aead.encrypt(output, plaintext, len);
+    aead.finish(tag);
+}
+
+// Расшифровывает и проверяет тег; при неверном теге output затирается и возвращается false
+bool ChaCha20Poly1305::open(uint8_t* output, const uint8_t* key, const uint8_t* nonce,
+                            const uint8_t* aad, size_t aad_len, const uint8_t* ciphertext, size_t len, const uint8_t* tag) {
+    ChaCha20Poly1305 aead(key, nonce);
+    aead.aad(aad, aad_len);
+    aead.decrypt(output, ciphertext, len);
+    if (!aead.verify(tag)) {
+        std::memset(output, 0, len);
+        return false;
+    }
+    return true;
+}
+
+void ChaCha20Poly1305::seal_precomputed(uint8_t* output, uint8_t* tag, const uint8_t* keystream,
+                                        const uint8_t* aad, size_t aad_len, const uint8_t* plaintext, size_t len) {
+    struct iovec part = { const_cast<uint8_t*>(plaintext), len };
+    seal_precomputed(output, tag, keystream, aad, aad_len, &part, 1);
+}
+
+void ChaCha20Poly1305::seal_precomputed(uint8_t* output, uint8_t* tag, const uint8_t* keystream,
+                                        const uint8_t* aad, size_t aad_len, const struct iovec* parts, size_t count) {
+    Poly1305 mac(keystream);
+    mac.update(aad, aad_len);
+    pad16(mac);
+
+    const uint8_t* stream = keystream + 64;
+    size_t total = 0;
+    for (size_t p = 0; p < count; ++p) {
+        const uint8_t* plaintext = static_cast<const uint8_t*>(parts[p].iov_base);
+        size_t len = parts[p].iov_len;
+
+        for (size_t done = 0; done < len; ) {
+            size_t part = len - done < FUSED_CHUNK ? len - done : FUSED_CHUNK;
+            for (size_t i = 0; i < part; ++i) {
+                output[i] = plaintext[done + i] ^ stream[i];
+            }
+            mac.update(output, part);
+            output += part;
+            stream += part;
+            done += part;
+        }
+        total += len;
+    }
+
+    finish_mac(mac, aad_len, total, tag);
+}
+
+#endif // CHACHA20POLY1305_H
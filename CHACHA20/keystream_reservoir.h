@@ -0,0 +1,180 @@
+#ifndef KEYSTREAM_RESERVOIR_H
+#define KEYSTREAM_RESERVOIR_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "chacha20poly1305.h"
+
+// Запас ключевого потока для исходящих записей одной сессии.
+// Nonce записей идут последовательно: 4 байта префикса стороны + 8 байт номера записи,
+// поэтому поток для следующих SLOT_COUNT записей известен заранее и считается фоновым потоком.
+// Короткая запись тогда шифруется одним XOR с готовым буфером; если слот еще не готов
+// или запись длиннее слота, используется обычный ChaCha20Poly1305 с тем же nonce.
+class KeystreamReservoir {
+public:
+    static const size_t SLOT_COUNT = 8;
+    static const size_t SLOT_PAYLOAD = 2048;        // максимальная длина записи, обслуживаемой из запаса
+    static const size_t SLOT_BYTES = 64 + SLOT_PAYLOAD; // блок 0 (ключ Poly1305) + поток для данных
+    static const size_t NONCE_LEN = 12;
+
+    KeystreamReservoir(const uint8_t* key, uint32_t noncePrefix, bool background = true);
+    ~KeystreamReservoir();
+
+    KeystreamReservoir(const KeystreamReservoir&) = delete;
+    KeystreamReservoir& operator=(const KeystreamReservoir&) = delete;
+
+    // Пишет запись nonce | шифртекст | тег в record (длина len + NONCE_LEN + TAG_LEN)
+    void seal_record(uint8_t* record, const uint8_t* plaintext, size_t len);
+    // То же, но открытый текст собирается из кусков; кусок может лежать прямо в record + NONCE_LEN
+    // (шифрование на месте). Возвращает длину записи.
+    size_t seal_record(uint8_t* record, const struct iovec* parts, size_t count);
+
+private:
+    enum SlotState { EMPTY, FILLING, READY, IN_USE };
+
+    struct Slot {
+        alignas(64) uint8_t stream[SLOT_BYTES];
+        uint64_t sequence;
+        SlotState state;
+    };
+
+    void make_nonce(uint64_t sequence, uint8_t* nonce) const;
+    void fill_loop();
+
+    uint8_t key[32];
+    uint32_t prefix;
+
+    Slot slots[SLOT_COUNT]; // запись с номером s живет в slots[s % SLOT_COUNT]
+    uint64_t next_sequence; // номер следующей отправляемой записи
+    uint64_t next_fill;     // номер следующей записи, для которой фоновый поток считает слот
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping;
+    std::thread filler;
+};
+
+KeystreamReservoir::KeystreamReservoir(const uint8_t* key, uint32_t noncePrefix, bool background)
+    : prefix(noncePrefix), next_sequence(0), next_fill(0), stopping(false) {
+    std::memcpy(this->key, key, sizeof(this->key));
+    for (auto& slot : slots) {
+        slot.sequence = 0;
+        slot.state = EMPTY;
+    }
+
+    if (background) {
+        filler = std::thread(&KeystreamReservoir::fill_loop, this);
+    }
+}
+
+KeystreamReservoir::~KeystreamReservoir() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (filler.joinable()) {
+        filler.join();
+    }
+
+    volatile uint8_t* wipe = key;
+    for (size_t i = 0; i < sizeof(key); ++i) wipe[i] = 0;
+    for (auto& slot : slots) {
+        wipe = slot.stream;
+        for (size_t i = 0; i < SLOT_BYTES; ++i) wipe[i] = 0;
+    }
+}
+
+void KeystreamReservoir::make_nonce(uint64_t sequence, uint8_t* nonce) const {
+    for (int i = 0; i < 4; ++i) {
+        nonce[i] = static_cast<uint8_t>(prefix >> (8 * i));
+    }
+    for (int i = 0; i < 8; ++i) {
+        nonce[4 + i] = static_cast<uint8_t>(sequence >> (8 * i));
+    }
+}
+
+// Фоновый поток держит готовыми слоты для записей [next_sequence, next_sequence + SLOT_COUNT)
+void KeystreamReservoir::fill_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        uint64_t target = 0;
+        Slot* slot = nullptr;
+
+        changed.wait(lock, [&] {
+            if (stopping) return true;
+            target = next_fill > next_sequence ? next_fill : next_sequence;
+            if (target >= next_sequence + SLOT_COUNT) return false;
+            slot = &slots[target % SLOT_COUNT];
+            // READY со старым номером - запись уже ушла обычным путем, слот можно переписать
+            return slot->state == EMPTY || (slot->state == READY && slot->sequence < next_sequence);
+        });
+        if (stopping) return;
+
+        slot->state = FILLING;
+        lock.unlock();
+
+        uint8_t nonce[NONCE_LEN];
+        make_nonce(target, nonce);
+        std::memset(slot->stream, 0, SLOT_BYTES);
+        ChaCha20::Context ctx(key, nonce, 0);
+        ctx.update(slot->stream, slot->stream, SLOT_BYTES);
+
+        lock.lock();
+        slot->sequence = target;
+        slot->state = READY;
+        next_fill = target + 1;
+    }
+}
+
+void KeystreamReservoir::seal_record(uint8_t* record, const uint8_t* plaintext, size_t len) {
+    struct iovec part = { const_cast<uint8_t*>(plaintext), len };
+    seal_record(record, &part, 1);
+}
+
+size_t KeystreamReservoir::seal_record(uint8_t* record, const struct iovec* parts, size_t count) {
+    size_t len = 0;
+    for (size_t i = 0; i < count; ++i) {
+        len += parts[i].iov_len;
+    }
+
+    uint8_t* nonce = record;
+    uint8_t* ciphertext = record + NONCE_LEN;
+    uint8_t* tag = ciphertext + len;
+
+    Slot* slot = nullptr;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sequence = next_sequence++;
+        Slot& candidate = slots[sequence % SLOT_COUNT];
+        if (len <= SLOT_PAYLOAD && candidate.state == READY && candidate.sequence == sequence) {
+            candidate.state = IN_USE;
+            slot = &candidate;
+        }
+    }
+    make_nonce(sequence, nonce);
+
+    if (slot != nullptr) {
+        ChaCha20Poly1305::seal_precomputed(ciphertext, tag, slot->stream, nullptr, 0, parts, count);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot->state = EMPTY;
+        }
+    } else {
+        ChaCha20Poly1305 aead(key, nonce);
+        uint8_t* out = ciphertext;
+        for (size_t i = 0; i < count; ++i) {
+            aead.encrypt(out, static_cast<const uint8_t*>(parts[i].iov_base), parts[i].iov_len);
+            out += parts[i].iov_len;
+        }
+        aead.finish(tag);
+    }
+    changed.notify_one();
+
+    return NONCE_LEN + len + ChaCha20Poly1305::TAG_LEN;
+}
+
+#endif // KEYSTREAM_RESERVOIR_H
@@ -0,0 +1,143 @@
+#ifndef CSPRNG_H
+#define CSPRNG_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <cstring>
+#include <pthread.h>
+#include <sys/random.h>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+#include "../CHACHA20/chacha20.h"
+
+// Криптографический генератор случайных чисел на ChaCha20 для всего процесса.
+// У каждого потока свой ключ, полученный из getrandom(2), и свой буфер потока ключей:
+// буфер заполняется одним вызовом ChaCha20, первые 32 байта сразу становятся новым ключом
+// (старый ключ после этого восстановить нельзя), остальное раздается по мере запросов,
+// выданные байты затираются. После fork ребенок получает копию буфера родителя, поэтому
+// обработчик pthread_atfork сдвигает поколение, и каждый поток при следующем запросе
+// заново берет ключ из getrandom.
+class CSPRNG {
+public:
+    static const size_t KEY_LEN = 32;
+    static const size_t BUFFER_LEN = 1024; // 16 блоков ChaCha20 - один проход широкого ядра
+
+    static void fill(uint8_t* buf, size_t len);
+    static uint64_t next_u64();
+
+    // Чтение из getrandom(2) с повтором при EINTR и неполном чтении
+    static void system_random(uint8_t* buf, size_t len);
+
+private:
+    struct State {
+        uint8_t key[KEY_LEN];
+        uint8_t buffer[BUFFER_LEN];
+        size_t available;            // непрочитанные байты лежат в конце буфера
+        unsigned long generation;
+        bool seeded;
+
+        State();
+        ~State();
+    };
+
+    static State& state();
+    static void refill(State& s);
+    static void reseed(State& s);
+    static void on_fork_child();
+
+    static std::atomic<unsigned long> fork_generation;
+    static std::once_flag atfork_registered;
+};
+
+std::atomic<unsigned long> CSPRNG::fork_generation(0);
+std::once_flag CSPRNG::atfork_registered;
+
+CSPRNG::State::State() : available(0), generation(0), seeded(false) {
+}
+
+CSPRNG::State::~State() {
+    volatile uint8_t* wipe = key;
+    for (size_t i = 0; i < KEY_LEN; ++i) wipe[i] = 0;
+    wipe = buffer;
+    for (size_t i = 0; i < BUFFER_LEN; ++i) wipe[i] = 0;
+}
+
+CSPRNG::State& CSPRNG::state() {
+    static thread_local State s;
+    return s;
+}
+
+void CSPRNG::on_fork_child() {
+    fork_generation.fetch_add(1);
+}
+
+void CSPRNG::system_random(uint8_t* buf, size_t len) {
+    while (len > 0) {
+        ssize_t got = getrandom(buf, len, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("getrandom failed.");
+        }
+        buf += got;
+        len -= static_cast<size_t>(got);
+    }
+}
+
+void CSPRNG::reseed(State& s) {
+    std::call_once(atfork_registered, [] {
+        if (pthread_atfork(nullptr, nullptr, &CSPRNG::on_fork_child) != 0) {
+            throw std::runtime_error("pthread_atfork failed.");
+        }
+    });
+
+    s.generation = fork_generation.load();
+    system_random(s.key, KEY_LEN);
+    s.available = 0;
+    s.seeded = true;
+}
+
+// Новый буфер из текущего ключа; nonce нулевой, так как ключ каждый раз новый
+void CSPRNG::refill(State& s) {
+    static const uint8_t nonce[12] = {0};
+    std::memset(s.buffer, 0, BUFFER_LEN);
+    ChaCha20::Context ctx(s.key, nonce, 0);
+    ctx.update(s.buffer, s.buffer, BUFFER_LEN);
+
+    std::memcpy(s.key, s.buffer, KEY_LEN);
+    std::memset(s.buffer, 0, KEY_LEN);
+    s.available = BUFFER_LEN - KEY_LEN;
+}
+
+void CSPRNG::fill(uint8_t* buf, size_t len) {
+    State& s = state();
+    if (!s.seeded || s.generation != fork_generation.load(std::memory_order_relaxed)) {
+        reseed(s);
+    }
+
+    while (len > 0) {
+        if (s.available == 0) {
+            refill(s);
+        }
+        size_t take = len < s.available ? len : s.available;
+        uint8_t* from = s.buffer + BUFFER_LEN - s.available;
+        std::memcpy(buf, from, take);
+        std::memset(from, 0, take);
+        s.available -= take;
+        buf += take;
+        len -= take;
+    }
+}
+
+uint64_t CSPRNG::next_u64() {
+    uint8_t bytes[8];
+    fill(bytes, sizeof(bytes));
+    uint64_t r = 0;
+    for (int i = 7; i >= 0; --i) {
+        r = (r << 8) | bytes[i];
+    }
+    return r;
+}
+
+#endif // CSPRNG_H
@@ -3,7 +3,10 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <random>
+#include "field51.h"
+#include "edwards25519.h"
+#include "x25519_avx2.h"
+#include "../CSPRNG/csprng.h"
 
 typedef unsigned char u8;
 typedef long long i64;
@@ -11,11 +14,28 @@ typedef i64 field_elem[16];
 typedef unsigned long long u64;
 
 class Curve25519 {
+public:
+    // Реализация арифметики поля: REFERENCE - исходный код TweetNaCl (16 лимбов по 16 бит),
+    // RADIX51 - 5 лимбов по 51 биту с произведениями в unsigned __int128
+    enum Backend {
+        REFERENCE,
+        RADIX51
+    };
+
+    static Backend backend();
+    static void set_backend(Backend b);
+
 private:
     static const field_elem _121665;
     static const u8 _9[32];
 
+    static Backend active_backend;
+
     static void scalarmult(u8 *out, const u8 *scalar, const u8 *point);
+    static void scalarmult_ref(u8 *out, const u8 *scalar, const u8 *point);
+    static void scalarmult51(u8 *out, const u8 *scalar, const u8 *point);
+    static void ladder51(Field51::elem x2, Field51::elem z2, const u8 *clamped, const u8 *point);
+    static void clamp(u8 *out, const u8 *scalar);
     static void randombytes(u8 *buf, u64 size);
     static void unpack25519(field_elem out, const u8 *in);
     static void carry25519(field_elem elem);
@@ -31,22 +51,33 @@ private:
 public:
     static void generate_keypair(u8 *pk, u8 *sk);
     static void x25519(u8 *out, const u8 *pk, const u8 *sk);
-};
 
-#endif
+    // count независимых x25519: out[i], pk[i], sk[i] - i-е 32-байтовые блоки массивов.
+    // Лестницы идут по четыре в AVX2, а деление на z делается одной инверсией на пачку.
+    static const size_t BATCH_SIZE = 64;
+    static void x25519_batch(u8 *out, const u8 *pk, const u8 *sk, size_t count);
+
+private:
+    static void batch_chunk(u8 *out, const u8 *pk, const u8 *sk, size_t count);
+};
 
 const field_elem Curve25519::_121665 = {0xDB41, 1};
 // extern void randombytes(u8 *, u64);
 const u8 Curve25519::_9[32] = {9};
 
-void Curve25519::randombytes(u8 *buf, u64 size) {
-    std::random_device rd; // Источник случайности
-    std::mt19937 gen(rd()); // Генератор случайных чисел
-    std::uniform_int_distribution<> dis(0, 255); // Диапазон: 0-255 (байты)
+Curve25519::Backend Curve25519::active_backend = Curve25519::RADIX51;
 
-    for (u64 i = 0; i < size; ++i) {
-        buf[i] = static_cast<u8>(dis(gen)); // Заполняем массив случайными байтами
-    }
+Curve25519::Backend Curve25519::backend() {
+    return active_backend;
+}
+
+// Переключение нужно для сверки результатов с эталонной реализацией
+void Curve25519::set_backend(Backend b) {
+    active_backend = b;
+}
+
+void Curve25519::randombytes(u8 *buf, u64 size) {
+    CSPRNG::fill(buf, size);
 }
 
 // Преобразует 32-байтовое число (массив in из 32 байт) в представление, состоящее из 16 элементов 16-битных целых чисел (field_elem).
@@ -158,8 +189,15 @@ void Curve25519::pack25519(u8 *out, const field_elem in) {
 }
 
 // Выполняет скалярное умножение со стандартной базовой точкой {д} , где  x = 9 .
+// Основной путь - таблица кратных базовой точки на кривой Эдвардса (без лестницы).
 void Curve25519::scalarmult_base(u8 *out, const u8 *scalar) {
-    scalarmult(out, scalar, _9);
+    if (active_backend == REFERENCE) {
+        scalarmult(out, scalar, _9);
+        return;
+    }
+    u8 clamped[32];
+    clamp(clamped, scalar);
+    Edwards25519::scalarmult_base(out, clamped);
 }
 
 // Генерирует пару ключей:
@@ -178,14 +216,28 @@ void Curve25519::x25519(u8 *out, const u8 *pk, const u8 *sk) {
   scalarmult(out, sk, pk);
 }
 
-// Выполняет скалярное умножение
+// Обнуляет три младших бита скаляра и выставляет бит 254 (RFC 7748)
+void Curve25519::clamp(u8 *out, const u8 *scalar) {
+    for (int i = 0; i < 32; ++i) out[i] = scalar[i];
+    out[0] &= 0xf8;
+    out[31] = (out[31] & 0x7f) | 0x40;
+}
+
+// Выполняет скалярное умножение выбранной реализацией
 void Curve25519::scalarmult(u8 *out, const u8 *scalar, const u8 *point) {
+    if (active_backend == REFERENCE) {
+        scalarmult_ref(out, scalar, point);
+    } else {
+        scalarmult51(out, scalar, point);
+    }
+}
+
+// Эталонная лестница Монтгомери на 16-битных лимбах
+void Curve25519::scalarmult_ref(u8 *out, const u8 *scalar, const u8 *point) {
     u8 clamped[32];
     i64 bit, i;
     field_elem a, b, c, d, e, f, x;
-    for (i = 0; i < 32; ++i) clamped[i] = scalar[i];
-    clamped[0] &= 0xf8;
-    clamped[31] = (clamped[31] & 0x7f) | 0x40;
+    clamp(clamped, scalar);
     unpack25519(x, point);
     for (i = 0; i < 16; ++i) {
         b[i] = x[i];
@@ -222,6 +274,131 @@ void Curve25519::scalarmult(u8 *out, const u8 *scalar, const u8 *point) {
     pack25519(out, a);
 }
 
+// Та же лестница на Field51; квадраты считаются отдельной процедурой
+void Curve25519::scalarmult51(u8 *out, const u8 *scalar, const u8 *point) {
+    u8 clamped[32];
+    Field51::elem x2, z2;
+    clamp(clamped, scalar);
+    ladder51(x2, z2, clamped, point);
+
+    Field51::invert(z2, z2);
+    Field51::mul(x2, x2, z2);
+    Field51::tobytes(out, x2);
+}
+
+// Лестница без финальной инверсии: результат в проективной форме (x2 : z2)
+void Curve25519::ladder51(Field51::elem x2, Field51::elem z2, const u8 *clamped, const u8 *point) {
+    Field51::elem a = {1}, b, c = {0}, d = {1}, e, f, x;
+    Field51::frombytes(x, point);
+    Field51::copy(b, x);
+
+    uint64_t swap = 0;
+    for (int i = 254; i >= 0; --i) {
+        uint64_t bit = (clamped[i >> 3] >> (i & 7)) & 1;
+        // меняем местами только при смене бита, последний обмен делается после цикла
+        swap ^= bit;
+        Field51::cswap(a, b, swap);
+        Field51::cswap(c, d, swap);
+        swap = bit;
+
+        Field51::add(e, a, c);
+        Field51::sub(a, a, c);
+        Field51::add(c, b, d);
+        Field51::sub(b, b, d);
+        Field51::sqr(d, e);
+        Field51::sqr(f, a);
+        Field51::mul(a, c, a);
+        Field51::mul(c, b, e);
+        Field51::add(e, a, c);
+        Field51::sub(a, a, c);
+        Field51::sqr(b, a);
+        Field51::sub(c, d, f);
+        Field51::mul_small(a, c, 121665);
+        Field51::add(a, a, d);
+        Field51::mul(c, c, a);
+        Field51::mul(a, d, f);
+        Field51::mul(d, b, x);
+        Field51::sqr(b, e);
+    }
+    Field51::cswap(a, b, swap);
+    Field51::cswap(c, d, swap);
+
+    Field51::copy(x2, a);
+    Field51::copy(z2, c);
+}
+
+void Curve25519::x25519_batch(u8 *out, const u8 *pk, const u8 *sk, size_t count) {
+    if (active_backend == REFERENCE) {
+        for (size_t i = 0; i < count; ++i) {
+            x25519(out + 32 * i, pk + 32 * i, sk + 32 * i);
+        }
+        return;
+    }
+    for (size_t done = 0; done < count; done += BATCH_SIZE) {
+        size_t n = count - done < BATCH_SIZE ? count - done : BATCH_SIZE;
+        batch_chunk(out + 32 * done, pk + 32 * done, sk + 32 * done, n);
+    }
+}
+
+// Не больше BATCH_SIZE умножений: лестницы, затем z^-1 для всех сразу (трюк Монтгомери).
+// Нулевой z (точка малого порядка) заменяется единицей, а результат такой записи - нулем,
+// как и в одиночном x25519; выбор делается маской, без ветвлений по секретным данным.
+void Curve25519::batch_chunk(u8 *out, const u8 *pk, const u8 *sk, size_t count) {
+    u8 clamped[BATCH_SIZE][32];
+    Field51::elem x2[BATCH_SIZE], z2[BATCH_SIZE], prefix[BATCH_SIZE];
+    uint64_t zero[BATCH_SIZE];
+
+    for (size_t i = 0; i < count; ++i) {
+        clamp(clamped[i], sk + 32 * i);
+    }
+
+    size_t i = 0;
+#ifdef CURVE25519_X86
+    if (X25519x4::supported()) {
+        for (; i + 4 <= count; i += 4) {
+            const uint8_t *scalars[4] = {clamped[i], clamped[i + 1], clamped[i + 2], clamped[i + 3]};
+            const uint8_t *points[4] = {pk + 32 * i, pk + 32 * (i + 1), pk + 32 * (i + 2), pk + 32 * (i + 3)};
+            X25519x4::ladder(x2 + i, z2 + i, scalars, points);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        ladder51(x2[i], z2[i], clamped[i], pk + 32 * i);
+    }
+
+    const Field51::elem one = {1};
+    for (i = 0; i < count; ++i) {
+        u8 bytes[32];
+        Field51::tobytes(bytes, z2[i]);
+        uint64_t acc = 0;
+        for (int k = 0; k < 32; ++k) acc |= bytes[k];
+        zero[i] = (acc - 1) >> 63;
+        Field51::cmov(z2[i], one, zero[i]);
+
+        if (i == 0) {
+            Field51::copy(prefix[0], z2[0]);
+        } else {
+            Field51::mul(prefix[i], prefix[i - 1], z2[i]);
+        }
+    }
+
+    Field51::elem inv, zinv;
+    Field51::invert(inv, prefix[count - 1]);
+    for (i = count; i-- > 0; ) {
+        if (i > 0) {
+            Field51::mul(zinv, inv, prefix[i - 1]);
+            Field51::mul(inv, inv, z2[i]);
+        } else {
+            Field51::copy(zinv, inv);
+        }
+        Field51::mul(x2[i], x2[i], zinv);
+        Field51::tobytes(out + 32 * i, x2[i]);
+
+        u8 mask = static_cast<u8>(zero[i] - 1);
+        for (int k = 0; k < 32; ++k) out[32 * i + k] &= mask;
+    }
+}
+
 // int main() {
 //     // Инициализация libsodium
 //     if (sodium_init() < 0) {
@@ -260,4 +437,6 @@ void Curve25519::scalarmult(u8 *out, const u8 *scalar, const u8 *point) {
 //     }
 
 //     return 0;
-// }
\ No newline at end of file
+// }
+
+#endif // CURVE25519_H
@@ -0,0 +1,282 @@
+#ifndef EDWARDS25519_H
+#define EDWARDS25519_H
+
+#include <stdint.h>
+
+#include "field51.h"
+
+// Умножение базовой точки на скаляр через скрученную кривую Эдвардса,
+// бирационально эквивалентную Curve25519: u = (1 + y) / (1 - y).
+// Скаляр записывается 64 знаковыми цифрами по основанию 16 (от -8 до 8), и
+// k*B = sum e[i] * 16^i * B складывается из таблицы j * 256^i * B, j = 1..8.
+// Таблица (32 x 8 точек) строится при компиляции; выбор из нее идет без ветвлений
+// и без зависящих от секрета адресов, поэтому время не зависит от скаляра.
+class Edwards25519 {
+public:
+    // out = u-координата clamped * базовая точка, тот же результат, что у лестницы с u = 9
+    static void scalarmult_base(uint8_t *out, const uint8_t *clamped);
+
+private:
+    struct P2 { Field51::elem X, Y, Z; };          // (X:Y:Z), x = X/Z, y = Y/Z
+    struct P3 { Field51::elem X, Y, Z, T; };       // расширенные координаты, XY = ZT
+    struct P1P1 { Field51::elem X, Y, Z, T; };     // результат сложения до приведения
+    struct Precomp { Field51::elem ypx, ymx, xy2d; }; // аффинная точка: y + x, y - x, 2dxy
+
+    struct BaseTable {
+        Precomp points[32][8]; // points[i][j] = (j + 1) * 256^i * B
+    };
+
+    // базовая точка, соответствующая u = 9
+    static constexpr uint8_t BASE_X[32] = {
+        0x1a, 0xd5, 0x25, 0x8f, 0x60, 0x2d, 0x56, 0xc9, 0xb2, 0xa7, 0x25, 0x95, 0x60, 0xc7, 0x2c, 0x69,
+        0x5c, 0xdc, 0xd6, 0xfd, 0x31, 0xe2, 0xa4, 0xc0, 0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21
+    };
+    static constexpr uint8_t BASE_Y[32] = {
+        0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+        0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+    };
+    static const BaseTable table;
+
+    static constexpr void curve_d2(Field51::elem out);
+    static constexpr void identity(P3 &p);
+    static constexpr void to_p2(P2 &r, const P1P1 &p);
+    static constexpr void to_p3(P3 &r, const P1P1 &p);
+    static constexpr void dbl(P1P1 &r, const P2 &p);
+    static constexpr void add(P1P1 &r, const P3 &p, const P3 &q, const Field51::elem d2);
+    static constexpr void madd(P1P1 &r, const P3 &p, const Precomp &q);
+    static constexpr BaseTable make_table();
+
+    static void select(Precomp &t, int pos, int8_t b);
+};
+
+// 2d, где d = -121665 / 121666 - параметр кривой
+constexpr void Edwards25519::curve_d2(Field51::elem out) {
+    Field51::elem num = {121665}, den = {121666}, zero = {};
+    Field51::invert(den, den);
+    Field51::mul(out, num, den);
+    Field51::sub(out, zero, out);
+    Field51::add(out, out, out);
+}
+
+constexpr void Edwards25519::identity(P3 &p) {
+    for (int i = 0; i < 5; ++i) {
+        p.X[i] = 0;
+        p.Y[i] = i == 0;
+        p.Z[i] = i == 0;
+        p.T[i] = 0;
+    }
+}
+
+constexpr void Edwards25519::to_p2(P2 &r, const P1P1 &p) {
+    Field51::mul(r.X, p.X, p.T);
+    Field51::mul(r.Y, p.Y, p.Z);
+    Field51::mul(r.Z, p.Z, p.T);
+}
+
+constexpr void Edwards25519::to_p3(P3 &r, const P1P1 &p) {
+    Field51::mul(r.X, p.X, p.T);
+    Field51::mul(r.Y, p.Y, p.Z);
+    Field51::mul(r.Z, p.Z, p.T);
+    Field51::mul(r.T, p.X, p.Y);
+}
+
+// Удвоение; T = 2Z^2 - (Y^2 - X^2) считается как (2Z^2 + X^2) - Y^2,
+// чтобы вычитаемое оставалось результатом умножения
+constexpr void Edwards25519::dbl(P1P1 &r, const P2 &p) {
+    Field51::elem xx = {}, yy = {}, b = {}, a = {};
+    Field51::sqr(xx, p.X);
+    Field51::sqr(yy, p.Y);
+    Field51::sqr(b, p.Z);
+    Field51::add(b, b, b);
+    Field51::add(a, p.X, p.Y);
+    Field51::sqr(a, a);
+
+    Field51::add(r.Y, yy, xx);
+    Field51::sub(r.Z, yy, xx);
+    Field51::sub(r.X, a, r.Y);
+    Field51::add(b, b, xx);
+    Field51::sub(r.T, b, yy);
+}
+
+// Сложение двух точек в расширенных координатах (нужно только при построении таблицы)
+constexpr void Edwards25519::add(P1P1 &r, const P3 &p, const P3 &q, const Field51::elem d2) {
+    Field51::elem a = {}, b = {}, c = {}, d = {}, t = {};
+    Field51::add(a, p.Y, p.X);
+    Field51::add(t, q.Y, q.X);
+    Field51::mul(a, a, t);
+    Field51::sub(b, p.Y, p.X);
+    Field51::sub(t, q.Y, q.X);
+    Field51::mul(b, b, t);
+    Field51::mul(t, q.T, d2);
+    Field51::mul(c, p.T, t);
+    Field51::mul(d, p.Z, q.Z);
+    Field51::add(d, d, d);
+
+    Field51::sub(r.X, a, b);
+    Field51::add(r.Y, a, b);
+    Field51::add(r.Z, d, c);
+    Field51::sub(r.T, d, c);
+}
+
+// Прибавление аффинной точки из таблицы
+constexpr void Edwards25519::madd(P1P1 &r, const P3 &p, const Precomp &q) {
+    Field51::elem a = {}, b = {}, c = {}, d = {};
+    Field51::add(a, p.Y, p.X);
+    Field51::mul(a, a, q.ypx);
+    Field51::sub(b, p.Y, p.X);
+    Field51::mul(b, b, q.ymx);
+    Field51::mul(c, p.T, q.xy2d);
+    Field51::add(d, p.Z, p.Z);
+
+    Field51::sub(r.X, a, b);
+    Field51::add(r.Y, a, b);
+    Field51::add(r.Z, d, c);
+    Field51::sub(r.T, d, c);
+}
+
+// Считает кратные в проективных координатах и переводит их в аффинные
+// одной общей инверсией (трюк Монтгомери)
+constexpr Edwards25519::BaseTable Edwards25519::make_table() {
+    BaseTable result = {};
+    P3 points[32][8] = {};
+    Field51::elem d2 = {};
+    curve_d2(d2);
+
+    P3 base = {};
+    Field51::frombytes(base.X, BASE_X);
+    Field51::frombytes(base.Y, BASE_Y);
+    base.Z[0] = 1;
+    Field51::mul(base.T, base.X, base.Y);
+
+    P1P1 r = {};
+    P2 p2 = {};
+    for (int i = 0; i < 32; ++i) {
+        points[i][0] = base;
+        for (int j = 1; j < 8; ++j) {
+            add(r, points[i][j - 1], base, d2);
+            to_p3(points[i][j], r);
+        }
+        // base *= 256
+        for (int k = 0; k < 8; ++k) {
+            Field51::copy(p2.X, base.X);
+            Field51::copy(p2.Y, base.Y);
+            Field51::copy(p2.Z, base.Z);
+            dbl(r, p2);
+            to_p3(base, r);
+        }
+    }
+
+    // prefix[n] = Z_0 * ... * Z_n
+    Field51::elem prefix[256] = {};
+    Field51::copy(prefix[0], points[0][0].Z);
+    for (int n = 1; n < 256; ++n) {
+        Field51::mul(prefix[n], prefix[n - 1], points[n / 8][n % 8].Z);
+    }
+    Field51::elem inv = {}, zinv = {}, x = {}, y = {};
+    Field51::invert(inv, prefix[255]);
+
+    for (int n = 255; n >= 0; --n) {
+        const P3 &p = points[n / 8][n % 8];
+        if (n > 0) {
+            Field51::mul(zinv, inv, prefix[n - 1]);
+            Field51::mul(inv, inv, p.Z);
+        } else {
+            Field51::copy(zinv, inv);
+        }
+        Field51::mul(x, p.X, zinv);
+        Field51::mul(y, p.Y, zinv);
+
+        Precomp &out = result.points[n / 8][n % 8];
+        Field51::add(out.ypx, y, x);
+        Field51::sub(out.ymx, y, x);
+        Field51::mul(out.xy2d, x, y);
+        Field51::mul(out.xy2d, out.xy2d, d2);
+    }
+    return result;
+}
+
+constexpr Edwards25519::BaseTable Edwards25519::table = Edwards25519::make_table();
+
+// t = b * 256^pos * B; перебираются все 8 точек строки, нужная выбирается маской
+void Edwards25519::select(Precomp &t, int pos, int8_t b) {
+    uint8_t negative = static_cast<uint8_t>(b) >> 7;
+    uint8_t babs = static_cast<uint8_t>((b ^ -negative) + negative);
+
+    for (int i = 0; i < 5; ++i) {
+        t.ypx[i] = i == 0;
+        t.ymx[i] = i == 0;
+        t.xy2d[i] = 0;
+    }
+    for (int j = 0; j < 8; ++j) {
+        uint64_t eq = static_cast<uint64_t>(static_cast<uint8_t>(babs ^ (j + 1)));
+        eq = (eq - 1) >> 63;
+        Field51::cmov(t.ypx, table.points[pos][j].ypx, eq);
+        Field51::cmov(t.ymx, table.points[pos][j].ymx, eq);
+        Field51::cmov(t.xy2d, table.points[pos][j].xy2d, eq);
+    }
+
+    // -P = (y - x, y + x, -2dxy)
+    Precomp minus = {};
+    Field51::elem zero = {};
+    Field51::copy(minus.ypx, t.ymx);
+    Field51::copy(minus.ymx, t.ypx);
+    Field51::sub(minus.xy2d, zero, t.xy2d);
+    Field51::cmov(t.ypx, minus.ypx, negative);
+    Field51::cmov(t.ymx, minus.ymx, negative);
+    Field51::cmov(t.xy2d, minus.xy2d, negative);
+}
+
+void Edwards25519::scalarmult_base(uint8_t *out, const uint8_t *clamped) {
+    int8_t e[64];
+    for (int i = 0; i < 32; ++i) {
+        e[2 * i] = clamped[i] & 15;
+        e[2 * i + 1] = (clamped[i] >> 4) & 15;
+    }
+    // цифры 0..15 переводятся в -8..7, старшая цифра не больше 8 (бит 255 сброшен)
+    int8_t carry = 0;
+    for (int i = 0; i < 63; ++i) {
+        e[i] += carry;
+        carry = static_cast<int8_t>((e[i] + 8) >> 4);
+        e[i] -= static_cast<int8_t>(carry * 16);
+    }
+    e[63] += carry;
+
+    P3 h = {};
+    P1P1 r = {};
+    P2 s = {};
+    Precomp t = {};
+    identity(h);
+
+    for (int i = 1; i < 64; i += 2) {
+        select(t, i / 2, e[i]);
+        madd(r, h, t);
+        to_p3(h, r);
+    }
+
+    // h *= 16
+    Field51::copy(s.X, h.X);
+    Field51::copy(s.Y, h.Y);
+    Field51::copy(s.Z, h.Z);
+    for (int k = 0; k < 3; ++k) {
+        dbl(r, s);
+        to_p2(s, r);
+    }
+    dbl(r, s);
+    to_p3(h, r);
+
+    for (int i = 0; i < 64; i += 2) {
+        select(t, i / 2, e[i]);
+        madd(r, h, t);
+        to_p3(h, r);
+    }
+
+    // u = (Z + Y) / (Z - Y)
+    Field51::elem num = {}, den = {};
+    Field51::add(num, h.Z, h.Y);
+    Field51::sub(den, h.Z, h.Y);
+    Field51::invert(den, den);
+    Field51::mul(num, num, den);
+    Field51::tobytes(out, num);
+}
+
+#endif // EDWARDS25519_H
@@ -0,0 +1,216 @@
+#ifndef FIELD51_H
+#define FIELD51_H
+
+#include <stdint.h>
+
+// Арифметика в поле по модулю 2^255 - 19 в системе счисления 2^51:
+// элемент - 5 лимбов по 51 биту, произведения лимбов считаются в unsigned __int128.
+// После mul/sqr/carry каждый лимб меньше 2^52, поэтому результат add/sub можно сразу умножать.
+// Все операции constexpr: на них же при компиляции строится таблица кратных базовой точки.
+class Field51 {
+public:
+    typedef uint64_t elem[5];
+
+    static constexpr void frombytes(elem out, const uint8_t *in);
+    static constexpr void tobytes(uint8_t *out, const elem in);
+    static constexpr void copy(elem out, const elem in);
+    static constexpr void add(elem out, const elem a, const elem b);
+    static constexpr void sub(elem out, const elem a, const elem b);
+    static constexpr void mul(elem out, const elem a, const elem b);
+    static constexpr void sqr(elem out, const elem a);
+    static constexpr void sqr_n(elem out, const elem a, int n);
+    static constexpr void mul_small(elem out, const elem a, uint32_t b);
+    static constexpr void invert(elem out, const elem in);
+    static constexpr void cswap(elem p, elem q, uint64_t bit);
+    static constexpr void cmov(elem out, const elem in, uint64_t bit);
+
+private:
+    static const uint64_t MASK51 = (1ULL << 51) - 1;
+
+    static constexpr uint64_t load64(const uint8_t *in);
+    static constexpr void carry(elem out, unsigned __int128 t0, unsigned __int128 t1, unsigned __int128 t2,
+                      unsigned __int128 t3, unsigned __int128 t4);
+};
+
+constexpr uint64_t Field51::load64(const uint8_t *in) {
+    uint64_t r = 0;
+    for (int i = 7; i >= 0; --i) {
+        r = (r << 8) | in[i];
+    }
+    return r;
+}
+
+// Старший бит входа отбрасывается, как и в unpack25519
+constexpr void Field51::frombytes(elem out, const uint8_t *in) {
+    out[0] = load64(in) & MASK51;
+    out[1] = (load64(in + 6) >> 3) & MASK51;
+    out[2] = (load64(in + 12) >> 6) & MASK51;
+    out[3] = (load64(in + 19) >> 1) & MASK51;
+    out[4] = (load64(in + 24) >> 12) & MASK51;
+}
+
+// Полная редукция: сначала нормализуем лимбы, затем вычитаем p, если число >= p
+constexpr void Field51::tobytes(uint8_t *out, const elem in) {
+    uint64_t t[5] = {in[0], in[1], in[2], in[3], in[4]};
+
+    for (int pass = 0; pass < 2; ++pass) {
+        t[1] += t[0] >> 51; t[0] &= MASK51;
+        t[2] += t[1] >> 51; t[1] &= MASK51;
+        t[3] += t[2] >> 51; t[2] &= MASK51;
+        t[4] += t[3] >> 51; t[3] &= MASK51;
+        t[0] += 19 * (t[4] >> 51); t[4] &= MASK51;
+    }
+
+    // q = 1, если t >= p: прибавляем 19 и смотрим на перенос за 2^255
+    uint64_t q = (t[0] + 19) >> 51;
+    q = (t[1] + q) >> 51;
+    q = (t[2] + q) >> 51;
+    q = (t[3] + q) >> 51;
+    q = (t[4] + q) >> 51;
+
+    t[0] += 19 * q;
+    t[1] += t[0] >> 51; t[0] &= MASK51;
+    t[2] += t[1] >> 51; t[1] &= MASK51;
+    t[3] += t[2] >> 51; t[2] &= MASK51;
+    t[4] += t[3] >> 51; t[3] &= MASK51;
+    t[4] &= MASK51;
+
+    uint64_t words[4] = {
+        t[0] | (t[1] << 51),
+        (t[1] >> 13) | (t[2] << 38),
+        (t[2] >> 26) | (t[3] << 25),
+        (t[3] >> 39) | (t[4] << 12),
+    };
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            out[8 * i + j] = static_cast<uint8_t>(words[i] >> (8 * j));
+        }
+    }
+}
+
+constexpr void Field51::copy(elem out, const elem in) {
+    for (int i = 0; i < 5; ++i) out[i] = in[i];
+}
+
+constexpr void Field51::add(elem out, const elem a, const elem b) {
+    for (int i = 0; i < 5; ++i) out[i] = a[i] + b[i];
+}
+
+// К a прибавляется 4p, чтобы лимбы не ушли в минус (b < 2^52 после mul/sqr)
+constexpr void Field51::sub(elem out, const elem a, const elem b) {
+    out[0] = (a[0] + 0x1FFFFFFFFFFFB4ULL) - b[0];
+    out[1] = (a[1] + 0x1FFFFFFFFFFFFCULL) - b[1];
+    out[2] = (a[2] + 0x1FFFFFFFFFFFFCULL) - b[2];
+    out[3] = (a[3] + 0x1FFFFFFFFFFFFCULL) - b[3];
+    out[4] = (a[4] + 0x1FFFFFFFFFFFFCULL) - b[4];
+}
+
+// Переносы после умножения: лимбы результата меньше 2^52
+constexpr void Field51::carry(elem out, unsigned __int128 t0, unsigned __int128 t1, unsigned __int128 t2,
+                    unsigned __int128 t3, unsigned __int128 t4) {
+    typedef unsigned __int128 u128;
+    uint64_t r0 = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0;
+    u128 c = 0;
+
+    r0 = static_cast<uint64_t>(t0) & MASK51; c = t0 >> 51;
+    t1 += c; r1 = static_cast<uint64_t>(t1) & MASK51; c = t1 >> 51;
+    t2 += c; r2 = static_cast<uint64_t>(t2) & MASK51; c = t2 >> 51;
+    t3 += c; r3 = static_cast<uint64_t>(t3) & MASK51; c = t3 >> 51;
+    t4 += c; r4 = static_cast<uint64_t>(t4) & MASK51; c = t4 >> 51;
+
+    c = c * 19 + r0;
+    r0 = static_cast<uint64_t>(c) & MASK51;
+    r1 += static_cast<uint64_t>(c >> 51);
+
+    out[0] = r0; out[1] = r1; out[2] = r2; out[3] = r3; out[4] = r4;
+}
+
+// 25 произведений вместо 256; старшие лимбы b заранее умножаются на 19 (2^255 = 19 mod p)
+constexpr void Field51::mul(elem out, const elem a, const elem b) {
+    typedef unsigned __int128 u128;
+    uint64_t b1_19 = b[1] * 19, b2_19 = b[2] * 19, b3_19 = b[3] * 19, b4_19 = b[4] * 19;
+
+    u128 t0 = (u128)a[0] * b[0] + (u128)a[1] * b4_19 + (u128)a[2] * b3_19 + (u128)a[3] * b2_19 + (u128)a[4] * b1_19;
+    u128 t1 = (u128)a[0] * b[1] + (u128)a[1] * b[0] + (u128)a[2] * b4_19 + (u128)a[3] * b3_19 + (u128)a[4] * b2_19;
+    u128 t2 = (u128)a[0] * b[2] + (u128)a[1] * b[1] + (u128)a[2] * b[0] + (u128)a[3] * b4_19 + (u128)a[4] * b3_19;
+    u128 t3 = (u128)a[0] * b[3] + (u128)a[1] * b[2] + (u128)a[2] * b[1] + (u128)a[3] * b[0] + (u128)a[4] * b4_19;
+    u128 t4 = (u128)a[0] * b[4] + (u128)a[1] * b[3] + (u128)a[2] * b[2] + (u128)a[3] * b[1] + (u128)a[4] * b[0];
+
+    carry(out, t0, t1, t2, t3, t4);
+}
+
+// Квадрат: симметричные произведения считаются один раз с удвоением, всего 15 умножений
+constexpr void Field51::sqr(elem out, const elem a) {
+    typedef unsigned __int128 u128;
+    uint64_t a0_2 = a[0] * 2, a1_2 = a[1] * 2;
+    uint64_t a1_38 = a[1] * 38, a2_38 = a[2] * 38, a3_38 = a[3] * 38;
+    uint64_t a3_19 = a[3] * 19, a4_19 = a[4] * 19;
+
+    u128 t0 = (u128)a[0] * a[0] + (u128)a1_38 * a[4] + (u128)a2_38 * a[3];
+    u128 t1 = (u128)a0_2 * a[1] + (u128)a2_38 * a[4] + (u128)a3_19 * a[3];
+    u128 t2 = (u128)a0_2 * a[2] + (u128)a[1] * a[1] + (u128)a3_38 * a[4];
+    u128 t3 = (u128)a0_2 * a[3] + (u128)a1_2 * a[2] + (u128)a4_19 * a[4];
+    u128 t4 = (u128)a0_2 * a[4] + (u128)a1_2 * a[3] + (u128)a[2] * a[2];
+
+    carry(out, t0, t1, t2, t3, t4);
+}
+
+constexpr void Field51::sqr_n(elem out, const elem a, int n) {
+    sqr(out, a);
+    for (int i = 1; i < n; ++i) {
+        sqr(out, out);
+    }
+}
+
+constexpr void Field51::mul_small(elem out, const elem a, uint32_t b) {
+    typedef unsigned __int128 u128;
+    carry(out, (u128)a[0] * b, (u128)a[1] * b, (u128)a[2] * b, (u128)a[3] * b, (u128)a[4] * b);
+}
+
+// in^(p-2) цепочкой сложений: 254 возведения в квадрат и 11 умножений
+constexpr void Field51::invert(elem out, const elem in) {
+    elem z2 = {}, z9 = {}, z11 = {}, z2_5_0 = {}, z2_10_0 = {}, z2_20_0 = {}, z2_50_0 = {}, z2_100_0 = {}, t = {};
+
+    sqr(z2, in);                  // 2
+    sqr_n(t, z2, 2);              // 8
+    mul(z9, t, in);               // 9
+    mul(z11, z9, z2);             // 11
+    sqr(t, z11);                  // 22
+    mul(z2_5_0, t, z9);           // 2^5 - 1
+    sqr_n(t, z2_5_0, 5);
+    mul(z2_10_0, t, z2_5_0);      // 2^10 - 1
+    sqr_n(t, z2_10_0, 10);
+    mul(z2_20_0, t, z2_10_0);     // 2^20 - 1
+    sqr_n(t, z2_20_0, 20);
+    mul(t, t, z2_20_0);           // 2^40 - 1
+    sqr_n(t, t, 10);
+    mul(z2_50_0, t, z2_10_0);     // 2^50 - 1
+    sqr_n(t, z2_50_0, 50);
+    mul(z2_100_0, t, z2_50_0);    // 2^100 - 1
+    sqr_n(t, z2_100_0, 100);
+    mul(t, t, z2_100_0);          // 2^200 - 1
+    sqr_n(t, t, 50);
+    mul(t, t, z2_50_0);           // 2^250 - 1
+    sqr_n(t, t, 5);               // 2^255 - 2^5
+    mul(out, t, z11);             // 2^255 - 21 = p - 2
+}
+
+// Меняет p и q местами, если bit == 1, без ветвлений
+constexpr void Field51::cswap(elem p, elem q, uint64_t bit) {
+    uint64_t mask = 0 - bit;
+    for (int i = 0; i < 5; ++i) {
+        uint64_t t = mask & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+// out = in, если bit == 1, без ветвлений
+constexpr void Field51::cmov(elem out, const elem in, uint64_t bit) {
+    uint64_t mask = 0 - bit;
+    for (int i = 0; i < 5; ++i) {
+        out[i] ^= mask & (out[i] ^ in[i]);
+    }
+}
+
+#endif // FIELD51_H
@@ -0,0 +1,258 @@
+#ifndef X25519_AVX2_H
+#define X25519_AVX2_H
+
+#include <stdint.h>
+
+#include "field51.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CURVE25519_X86
+#include <immintrin.h>
+#endif
+
+#ifdef CURVE25519_X86
+
+// Четыре независимые лестницы Монтгомери в регистрах AVX2, по одной в каждой 64-битной полосе.
+// Элемент поля - 10 лимбов попеременно по 26 и 25 бит (2^25.5), так что произведения лимбов
+// помещаются в _mm256_mul_epu32 (32 x 32 -> 64 бита). Лимбы беззнаковые: вычитание
+// добавляет 2p, а все границы подобраны так, чтобы множитель 19 не выводил операнд за 32 бита.
+class X25519x4 {
+public:
+    static bool supported();
+
+    // Для каждой полосы l: (x2[l] : z2[l]) = clamped[l] * point[l], результат в Field51 без инверсии
+    static void ladder(Field51::elem x2[4], Field51::elem z2[4],
+                       const uint8_t *const clamped[4], const uint8_t *const points[4]);
+
+private:
+    struct fe4 { __m256i v[10]; };
+
+    static void frombytes(fe4 &out, const uint8_t *const in[4]);
+    static void to_field51(Field51::elem out[4], const fe4 &in);
+    static void add(fe4 &out, const fe4 &a, const fe4 &b);
+    static void sub(fe4 &out, const fe4 &a, const fe4 &b);
+    static void carry(fe4 &out, __m256i h[10]);
+    static void mul(fe4 &out, const fe4 &f, const fe4 &g);
+    static void sqr(fe4 &out, const fe4 &f);
+    static void mul121665(fe4 &out, const fe4 &f);
+    static void cswap(fe4 &p, fe4 &q, __m256i mask);
+};
+
+bool X25519x4::supported() {
+    return __builtin_cpu_supports("avx2");
+}
+
+// Лимб i начинается с бита ceil(25.5 * i); последний лимб кончается на бите 254, бит 255 отбрасывается
+__attribute__((target("avx2")))
+void X25519x4::frombytes(fe4 &out, const uint8_t *const in[4]) {
+    static const int shift[10] = {0, 26, 51, 77, 102, 128, 153, 179, 204, 230};
+    uint64_t limbs[4][10];
+    for (int l = 0; l < 4; ++l) {
+        for (int i = 0; i < 10; ++i) {
+            int bit = shift[i];
+            int width = (i & 1) ? 25 : 26;
+            uint64_t w = 0;
+            for (int b = 4; b >= 0; --b) {
+                int idx = bit / 8 + b;
+                w = (w << 8) | (idx < 32 ? in[l][idx] : 0);
+            }
+            limbs[l][i] = (w >> (bit % 8)) & ((1ULL << width) - 1);
+        }
+    }
+    for (int i = 0; i < 10; ++i) {
+        out.v[i] = _mm256_set_epi64x(limbs[3][i], limbs[2][i], limbs[1][i], limbs[0][i]);
+    }
+}
+
+// Пары лимбов (26 + 25 бит) складываются в один 51-битный лимб Field51
+__attribute__((target("avx2")))
+void X25519x4::to_field51(Field51::elem out[4], const fe4 &in) {
+    alignas(32) uint64_t lanes[10][4];
+    for (int i = 0; i < 10; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[i]), in.v[i]);
+    }
+    for (int l = 0; l < 4; ++l) {
+        for (int k = 0; k < 5; ++k) {
+            out[l][k] = lanes[2 * k][l] + (lanes[2 * k + 1][l] << 26);
+        }
+    }
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void X25519x4::add(fe4 &out, const fe4 &a, const fe4 &b) {
+    for (int i = 0; i < 10; ++i) {
+        out.v[i] = _mm256_add_epi64(a.v[i], b.v[i]);
+    }
+}
+
+// a + 2p - b; b - результат mul/sqr (лимбы не больше 2^26 и 2^25)
+__attribute__((target("avx2"), always_inline))
+inline void X25519x4::sub(fe4 &out, const fe4 &a, const fe4 &b) {
+    const __m256i two_p0 = _mm256_set1_epi64x(0x7FFFFDA);
+    const __m256i two_p_even = _mm256_set1_epi64x(0x7FFFFFE);
+    const __m256i two_p_odd = _mm256_set1_epi64x(0x3FFFFFE);
+    out.v[0] = _mm256_sub_epi64(_mm256_add_epi64(a.v[0], two_p0), b.v[0]);
+    for (int i = 1; i < 10; ++i) {
+        out.v[i] = _mm256_sub_epi64(_mm256_add_epi64(a.v[i], (i & 1) ? two_p_odd : two_p_even), b.v[i]);
+    }
+}
+
+// x * 19 = x * 16 + x * 2 + x, сдвигами, чтобы не занимать порт умножения
+__attribute__((target("avx2"), always_inline))
+inline __m256i times19(__m256i x) {
+    return _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(x, 4), _mm256_slli_epi64(x, 1)), x);
+}
+
+// Перенос из лимба i в следующий; из последнего - в нулевой с множителем 19 (2^255 = 19)
+template <int i>
+__attribute__((target("avx2"), always_inline))
+inline void carry_step(__m256i h[10]) {
+    const int bits = (i & 1) ? 25 : 26;
+    __m256i c = _mm256_srli_epi64(h[i], bits);
+    h[i] = _mm256_and_si256(h[i], _mm256_set1_epi64x((1LL << bits) - 1));
+    if (i == 9) {
+        h[0] = _mm256_add_epi64(h[0], times19(c));
+    } else {
+        h[(i + 1) % 10] = _mm256_add_epi64(h[(i + 1) % 10], c);
+    }
+}
+
+// Переносы в порядке ref10: две цепочки идут вперемешку, чтобы сократить зависимость
+__attribute__((target("avx2"), always_inline))
+inline void X25519x4::carry(fe4 &out, __m256i h[10]) {
+    carry_step<0>(h); carry_step<4>(h);
+    carry_step<1>(h); carry_step<5>(h);
+    carry_step<2>(h); carry_step<6>(h);
+    carry_step<3>(h); carry_step<7>(h);
+    carry_step<4>(h); carry_step<8>(h);
+    carry_step<9>(h);
+    carry_step<0>(h);
+    for (int i = 0; i < 10; ++i) {
+        out.v[i] = h[i];
+    }
+}
+
+// h_k = sum f_i * g_j (i + j = k mod 10); x2 при нечетных i и j, x19 при i + j >= 10
+__attribute__((target("avx2")))
+void X25519x4::mul(fe4 &out, const fe4 &f, const fe4 &g) {
+    __m256i f2[10], g19[10], h[10];
+    for (int i = 0; i < 10; ++i) {
+        f2[i] = (i & 1) ? _mm256_add_epi64(f.v[i], f.v[i]) : f.v[i];
+        g19[i] = times19(g.v[i]);
+        h[i] = _mm256_setzero_si256();
+    }
+#pragma GCC unroll 10
+    for (int i = 0; i < 10; ++i) {
+#pragma GCC unroll 10
+        for (int j = 0; j < 10; ++j) {
+            __m256i a = ((i & 1) && (j & 1)) ? f2[i] : f.v[i];
+            __m256i b = (i + j >= 10) ? g19[j] : g.v[j];
+            int k = (i + j) % 10;
+            h[k] = _mm256_add_epi64(h[k], _mm256_mul_epu32(a, b));
+        }
+    }
+    carry(out, h);
+}
+
+// Квадрат: каждая пара i < j считается один раз с удвоением первого множителя
+__attribute__((target("avx2")))
+void X25519x4::sqr(fe4 &out, const fe4 &f) {
+    __m256i f2[10], f19[10], f38[10], h[10];
+    for (int i = 0; i < 10; ++i) {
+        f2[i] = _mm256_add_epi64(f.v[i], f.v[i]);
+        f19[i] = times19(f.v[i]);
+        f38[i] = _mm256_add_epi64(f19[i], f19[i]);
+        h[i] = _mm256_setzero_si256();
+    }
+#pragma GCC unroll 10
+    for (int i = 0; i < 10; ++i) {
+#pragma GCC unroll 10
+        for (int j = i; j < 10; ++j) {
+            bool both_odd = (i & 1) && (j & 1);
+            __m256i a = (i < j) ? f2[i] : f.v[i];
+            __m256i b;
+            if (i + j >= 10) {
+                b = both_odd ? f38[j] : f19[j];
+            } else {
+                b = both_odd ? f2[j] : f.v[j];
+            }
+            int k = (i + j) % 10;
+            h[k] = _mm256_add_epi64(h[k], _mm256_mul_epu32(a, b));
+        }
+    }
+    carry(out, h);
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void X25519x4::mul121665(fe4 &out, const fe4 &f) {
+    const __m256i k = _mm256_set1_epi64x(121665);
+    __m256i h[10];
+    for (int i = 0; i < 10; ++i) {
+        h[i] = _mm256_mul_epu32(f.v[i], k);
+    }
+    carry(out, h);
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void X25519x4::cswap(fe4 &p, fe4 &q, __m256i mask) {
+    for (int i = 0; i < 10; ++i) {
+        __m256i t = _mm256_and_si256(mask, _mm256_xor_si256(p.v[i], q.v[i]));
+        p.v[i] = _mm256_xor_si256(p.v[i], t);
+        q.v[i] = _mm256_xor_si256(q.v[i], t);
+    }
+}
+
+// Та же последовательность операций, что и в Curve25519::scalarmult51
+__attribute__((target("avx2")))
+void X25519x4::ladder(Field51::elem x2[4], Field51::elem z2[4],
+                      const uint8_t *const clamped[4], const uint8_t *const points[4]) {
+    fe4 a, b, c, d, e, f, x;
+    frombytes(x, points);
+    for (int i = 0; i < 10; ++i) {
+        a.v[i] = _mm256_set1_epi64x(i == 0);
+        b.v[i] = x.v[i];
+        c.v[i] = _mm256_setzero_si256();
+        d.v[i] = a.v[i];
+    }
+
+    __m256i swap = _mm256_setzero_si256();
+    for (int i = 254; i >= 0; --i) {
+        __m256i bit = _mm256_set_epi64x(
+            -static_cast<int64_t>((clamped[3][i >> 3] >> (i & 7)) & 1),
+            -static_cast<int64_t>((clamped[2][i >> 3] >> (i & 7)) & 1),
+            -static_cast<int64_t>((clamped[1][i >> 3] >> (i & 7)) & 1),
+            -static_cast<int64_t>((clamped[0][i >> 3] >> (i & 7)) & 1));
+        swap = _mm256_xor_si256(swap, bit);
+        cswap(a, b, swap);
+        cswap(c, d, swap);
+        swap = bit;
+
+        add(e, a, c);
+        sub(a, a, c);
+        add(c, b, d);
+        sub(b, b, d);
+        sqr(d, e);
+        sqr(f, a);
+        mul(a, a, c);
+        mul(c, b, e);
+        add(e, a, c);
+        sub(a, a, c);
+        sqr(b, a);
+        sub(c, d, f);
+        mul121665(a, c);
+        add(a, a, d);
+        mul(c, c, a);
+        mul(a, d, f);
+        mul(d, b, x);
+        sqr(b, e);
+    }
+    cswap(a, b, swap);
+    cswap(c, d, swap);
+
+    to_field51(x2, a);
+    to_field51(z2, c);
+}
+
+#endif // CURVE25519_X86
+
+#endif // X25519_AVX2_H
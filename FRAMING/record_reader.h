@@ -0,0 +1,139 @@
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+// Прием записей одного соединения. Запись на проводе - длина тела (HEADER_LEN байт, big-endian)
+// и само тело. TCP может склеить несколько записей в один recv или разрезать одну на несколько,
+// поэтому байты копятся в кольцевом буфере, а наружу отдаются только целые записи.
+// Кольцо отображено в память дважды подряд (одни и те же страницы memfd по адресам base и
+// base + capacity), поэтому любой кусок до capacity байт, начиная с любого места кольца,
+// лежит в памяти непрерывно: запись отдается указателем прямо в кольцо и расшифровывается
+// на месте, а recv пишет сразу во все свободное место. Ни копий, ни выделений на запись.
+class RecordReader {
+public:
+    static const size_t HEADER_LEN = 4;
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    enum Status {
+        RECORD,     // в record и length - тело следующей записи
+        CLOSED,     // соединение закрыто (недочитанный хвост отбрасывается)
+        FAILED,     // ошибка recv
+        OVERSIZED   // длина записи больше maxRecord(): поток дальше не разобрать
+    };
+
+    // capacity округляется вверх до размера страницы
+    explicit RecordReader(int socket, size_t capacity = DEFAULT_CAPACITY);
+    ~RecordReader();
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    // Следующая целая запись. Тело лежит внутри кольца, его можно менять на месте;
+    // указатель действителен до следующего вызова next
+    Status next(char** record, size_t* length);
+
+    // Наибольшее тело записи, которое помещается в кольцо
+    size_t maxRecord() const;
+
+    // Длина тела впереди кадра: frame[0..HEADER_LEN)
+    static void writeHeader(char* frame, size_t length);
+
+private:
+    int socket;
+    size_t capacity;
+    char* base;
+    size_t head;       // начало непрочитанных данных, 0 <= head < capacity
+    size_t used;       // сколько байт принято и еще не отдано
+    size_t consumed;   // длина кадра, отданного прошлым next; освобождается в следующем
+};
+
+RecordReader::RecordReader(int socket, size_t capacity) : socket(socket), base(nullptr), head(0), used(0), consumed(0) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    this->capacity = (capacity + page - 1) / page * page;
+    if (this->capacity <= HEADER_LEN) {
+        throw std::runtime_error("Record buffer is too small.");
+    }
+
+    int fd = memfd_create("record-ring", 0);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to create record buffer.");
+    }
+    if (ftruncate(fd, this->capacity) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to size record buffer.");
+    }
+
+    // сначала резервируем 2 * capacity адресов, затем кладем в обе половины одни и те же страницы
+    void* area = mmap(nullptr, 2 * this->capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Unable to map record buffer.");
+    }
+    char* low = static_cast<char*>(area);
+    bool mapped = mmap(low, this->capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+                  && mmap(low + this->capacity, this->capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+    close(fd);   // отображения держат страницы сами
+    if (!mapped) {
+        munmap(area, 2 * this->capacity);
+        throw std::runtime_error("Unable to map record buffer.");
+    }
+    base = low;
+}
+
+RecordReader::~RecordReader() {
+    munmap(base, 2 * capacity);
+}
+
+size_t RecordReader::maxRecord() const {
+    return capacity - HEADER_LEN;
+}
+
+void RecordReader::writeHeader(char* frame, size_t length) {
+    for (size_t i = 0; i < HEADER_LEN; ++i) {
+        frame[i] = static_cast<char>(length >> (8 * (HEADER_LEN - 1 - i)));
+    }
+}
+
+RecordReader::Status RecordReader::next(char** record, size_t* length) {
+    head = (head + consumed) % capacity;
+    used -= consumed;
+    consumed = 0;
+
+    while (true) {
+        if (used >= HEADER_LEN) {
+            const unsigned char* frame = reinterpret_cast<const unsigned char*>(base + head);
+            size_t bodyLength = 0;
+            for (size_t i = 0; i < HEADER_LEN; ++i) {
+                bodyLength = (bodyLength << 8) | frame[i];
+            }
+            if (bodyLength > maxRecord()) {
+                return OVERSIZED;
+            }
+            if (used >= HEADER_LEN + bodyLength) {
+                *record = base + head + HEADER_LEN;
+                *length = bodyLength;
+                consumed = HEADER_LEN + bodyLength;
+                return RECORD;
+            }
+        }
+
+        // свободное место за данными непрерывно благодаря второй копии кольца
+        ssize_t bytesRead = recv(socket, base + head + used, capacity - used, 0);
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return FAILED;
+        }
+        if (bytesRead == 0) {
+            return CLOSED;
+        }
+        used += static_cast<size_t>(bytesRead);
+    }
+}
+
+#endif // RECORD_READER_H
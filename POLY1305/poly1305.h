@@ -0,0 +1,362 @@
+#ifndef POLY1305_H
+#define POLY1305_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define POLY1305_X86 1
+#include <immintrin.h>
+#else
+#define POLY1305_X86 0
+#endif
+
+// Одноразовый MAC Poly1305 (RFC 8439). Аккумулятор хранится в пяти 26-битных лимбах,
+// поэтому одно и то же представление используется и в скалярном коде, и в AVX2-ядре,
+// которое ведет четыре независимые цепочки Горнера по блокам 4i, 4i+1, 4i+2, 4i+3
+// и умножает их на r^4 за шаг.
+class Poly1305 {
+public:
+    static const size_t KEY_LEN = 32;
+    static const size_t TAG_LEN = 16;
+
+    explicit Poly1305(const uint8_t* key);
+    ~Poly1305();
+
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t* tag);
+
+    // Сколько байт уже подано в update (нужно AEAD для выравнивания до 16)
+    uint64_t length() const;
+
+    static void mac(uint8_t* tag, const uint8_t* key, const uint8_t* data, size_t len);
+    static bool verify(const uint8_t* a, const uint8_t* b);
+
+private:
+    void blocks(const uint8_t* data, size_t nblocks, uint32_t hibit);
+    void blocks_avx2(const uint8_t* data, size_t nblocks);
+    static void mul(uint32_t* h, const uint32_t* r);
+    static void load_block(const uint8_t* block, uint32_t* limbs, uint32_t hibit);
+    static bool has_avx2();
+
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+    uint32_t r_pow[4][5]; // r^1 .. r^4 для векторного пути (считаются при первой надобности)
+    bool powers_ready;
+
+    uint8_t buffer[16];
+    size_t leftover;
+    uint64_t total;
+};
+
+static inline uint32_t poly1305_load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline void poly1305_store32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+Poly1305::Poly1305(const uint8_t* key) : powers_ready(false), leftover(0), total(0) {
+    // r ограничивается (clamp) согласно спецификации и раскладывается на 26-битные лимбы
+    r[0] = (poly1305_load32(key + 0)) & 0x3ffffff;
+    r[1] = (poly1305_load32(key + 3) >> 2) & 0x3ffff03;
+    r[2] = (poly1305_load32(key + 6) >> 4) & 0x3ffc0ff;
+    r[3] = (poly1305_load32(key + 9) >> 6) & 0x3f03fff;
+    r[4] = (poly1305_load32(key + 12) >> 8) & 0x00fffff;
+
+    for (int i = 0; i < 5; ++i) h[i] = 0;
+    for (int i = 0; i < 4; ++i) pad[i] = poly1305_load32(key + 16 + 4 * i);
+}
+
+Poly1305::~Poly1305() {
+    // Ключ одноразовый, но затираем его, чтобы он не оставался на стеке
+    volatile uint32_t* p = r;
+    for (int i = 0; i < 5; ++i) p[i] = 0;
+    p = pad;
+    for (int i = 0; i < 4; ++i) p[i] = 0;
+}
+
+uint64_t Poly1305::length() const {
+    return total;
+}
+
+bool Poly1305::has_avx2() {
+#if POLY1305_X86
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// 16 байт сообщения -> пять 26-битных лимбов, hibit - добавляемый 2^128 (0 для последнего неполного блока)
+void Poly1305::load_block(const uint8_t* block, uint32_t* limbs, uint32_t hibit) {
+    limbs[0] = (poly1305_load32(block + 0)) & 0x3ffffff;
+    limbs[1] = (poly1305_load32(block + 3) >> 2) & 0x3ffffff;
+    limbs[2] = (poly1305_load32(block + 6) >> 4) & 0x3ffffff;
+    limbs[3] = (poly1305_load32(block + 9) >> 6) & 0x3ffffff;
+    limbs[4] = (poly1305_load32(block + 12) >> 8) | hibit;
+}
+
+// h = h * r mod (2^130 - 5) с частичным переносом (лимбы остаются чуть больше 26 бит)
+void Poly1305::mul(uint32_t* h, const uint32_t* r) {
+    const uint32_t s1 = r[1] * 5, s2 = r[2] * 5, s3 = r[3] * 5, s4 = r[4] * 5;
+    const uint64_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+
+    uint64_t d0 = h0 * r[0] + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+    uint64_t d1 = h0 * r[1] + h1 * r[0] + h2 * s4 + h3 * s3 + h4 * s2;
+    uint64_t d2 = h0 * r[2] + h1 * r[1] + h2 * r[0] + h3 * s4 + h4 * s3;
+    uint64_t d3 = h0 * r[3] + h1 * r[2] + h2 * r[1] + h3 * r[0] + h4 * s4;
+    uint64_t d4 = h0 * r[4] + h1 * r[3] + h2 * r[2] + h3 * r[1] + h4 * r[0];
+
+    uint64_t c;
+    c = d0 >> 26; h[0] = d0 & 0x3ffffff; d1 += c;
+    c = d1 >> 26; h[1] = d1 & 0x3ffffff; d2 += c;
+    c = d2 >> 26; h[2] = d2 & 0x3ffffff; d3 += c;
+    c = d3 >> 26; h[3] = d3 & 0x3ffffff; d4 += c;
+    c = d4 >> 26; h[4] = d4 & 0x3ffffff;
+    h[0] += static_cast<uint32_t>(c * 5);
+    c = h[0] >> 26; h[0] &= 0x3ffffff; h[1] += static_cast<uint32_t>(c);
+}
+
+void Poly1305::blocks(const uint8_t* data, size_t nblocks, uint32_t hibit) {
+    // Векторный путь выгоден только когда есть хотя бы пара шагов по r^4
+    if (hibit != 0 && nblocks >= 8 && has_avx2()) {
+        size_t vec = nblocks & ~static_cast<size_t>(3);
+        blocks_avx2(data, vec);
+        data += vec * 16;
+        nblocks -= vec;
+    }
+
+    for (; nblocks > 0; --nblocks, data += 16) {
+        uint32_t m[5];
+        load_block(data, m, hibit);
+        for (int i = 0; i < 5; ++i) h[i] += m[i];
+        mul(h, r);
+    }
+}
+
+#if POLY1305_X86
+
+// Четыре лимба-вектора: лимб i всех четырех цепочек в 64-битных полосах
+__attribute__((target("avx2")))
+static inline void poly1305_load4_avx2(const uint8_t* m, __m256i* limbs) {
+    const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));      // блоки 0, 1
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m + 32)); // блоки 2, 3
+    // Младшие и старшие 64 бита каждого блока, полосы в порядке блоков 0, 1, 2, 3
+    __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8);
+    __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8);
+
+    limbs[0] = _mm256_and_si256(lo, mask);
+    limbs[1] = _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask);
+    limbs[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask);
+    limbs[3] = _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask);
+    limbs[4] = _mm256_or_si256(_mm256_srli_epi64(hi, 40), _mm256_set1_epi64x(1 << 24));
+}
+
+// H = H * R по каждой полосе, с частичным переносом
+__attribute__((target("avx2")))
+static inline void poly1305_mul4_avx2(__m256i* hv, const __m256i* rv, const __m256i* sv) {
+    __m256i d0 = _mm256_mul_epu32(hv[0], rv[0]);
+    d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(hv[1], sv[4]));
+    d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(hv[2], sv[3]));
+    d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(hv[3], sv[2]));
+    d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(hv[4], sv[1]));
+
+    __m256i d1 = _mm256_mul_epu32(hv[0], rv[1]);
+    d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(hv[1], rv[0]));
+    d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(hv[2], sv[4]));
+    d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(hv[3], sv[3]));
+    d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(hv[4], sv[2]));
+
+    __m256i d2 = _mm256_mul_epu32(hv[0], rv[2]);
+    d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(hv[1], rv[1]));
+    d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(hv[2], rv[0]));
+    d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(hv[3], sv[4]));
+    d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(hv[4], sv[3]));
+
+    __m256i d3 = _mm256_mul_epu32(hv[0], rv[3]);
+    d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(hv[1], rv[2]));
+    d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(hv[2], rv[1]));
+    d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(hv[3], rv[0]));
+    d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(hv[4], sv[4]));
+
+    __m256i d4 = _mm256_mul_epu32(hv[0], rv[4]);
+    d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(hv[1], rv[3]));
+    d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(hv[2], rv[2]));
+    d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(hv[3], rv[1]));
+    d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(hv[4], rv[0]));
+
+    const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+    __m256i c;
+    c = _mm256_srli_epi64(d0, 26); d0 = _mm256_and_si256(d0, mask); d1 = _mm256_add_epi64(d1, c);
+    c = _mm256_srli_epi64(d1, 26); d1 = _mm256_and_si256(d1, mask); d2 = _mm256_add_epi64(d2, c);
+    c = _mm256_srli_epi64(d2, 26); d2 = _mm256_and_si256(d2, mask); d3 = _mm256_add_epi64(d3, c);
+    c = _mm256_srli_epi64(d3, 26); d3 = _mm256_and_si256(d3, mask); d4 = _mm256_add_epi64(d4, c);
+    c = _mm256_srli_epi64(d4, 26); d4 = _mm256_and_si256(d4, mask);
+    d0 = _mm256_add_epi64(d0, _mm256_add_epi64(c, _mm256_slli_epi64(c, 2))); // c * 5
+    c = _mm256_srli_epi64(d0, 26); d0 = _mm256_and_si256(d0, mask); d1 = _mm256_add_epi64(d1, c);
+
+    hv[0] = d0; hv[1] = d1; hv[2] = d2; hv[3] = d3; hv[4] = d4;
+}
+
+// nblocks кратно 4: полоса j накапливает блоки j, j+4, j+8, ... с множителем r^4,
+// в конце полосы умножаются на r^4, r^3, r^2, r и складываются
+__attribute__((target("avx2")))
+void Poly1305::blocks_avx2(const uint8_t* data, size_t nblocks) {
+    if (!powers_ready) {
+        for (int i = 0; i < 5; ++i) r_pow[0][i] = r[i];
+        for (int p = 1; p < 4; ++p) {
+            for (int i = 0; i < 5; ++i) r_pow[p][i] = r_pow[p - 1][i];
+            mul(r_pow[p], r);
+        }
+        powers_ready = true;
+    }
+
+    __m256i r4[5], s4[5], rf[5], sf[5];
+    for (int i = 0; i < 5; ++i) {
+        r4[i] = _mm256_set1_epi64x(r_pow[3][i]);
+        s4[i] = _mm256_set1_epi64x(r_pow[3][i] * 5);
+        rf[i] = _mm256_set_epi64x(r_pow[0][i], r_pow[1][i], r_pow[2][i], r_pow[3][i]);
+        sf[i] = _mm256_set_epi64x(r_pow[0][i] * 5, r_pow[1][i] * 5, r_pow[2][i] * 5, r_pow[3][i] * 5);
+    }
+
+    __m256i hv[5];
+    poly1305_load4_avx2(data, hv);
+    for (int i = 0; i < 5; ++i) {
+        hv[i] = _mm256_add_epi64(hv[i], _mm256_set_epi64x(0, 0, 0, h[i]));
+    }
+
+    for (size_t b = 4; b < nblocks; b += 4) {
+        poly1305_mul4_avx2(hv, r4, s4);
+        __m256i m[5];
+        poly1305_load4_avx2(data + b * 16, m);
+        for (int i = 0; i < 5; ++i) hv[i] = _mm256_add_epi64(hv[i], m[i]);
+    }
+    poly1305_mul4_avx2(hv, rf, sf);
+
+    // Сумма полос и перенос обратно в скалярный аккумулятор
+    uint64_t d[5];
+    for (int i = 0; i < 5; ++i) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), hv[i]);
+        d[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    uint64_t c;
+    c = d[0] >> 26; d[0] &= 0x3ffffff; d[1] += c;
+    c = d[1] >> 26; d[1] &= 0x3ffffff; d[2] += c;
+    c = d[2] >> 26; d[2] &= 0x3ffffff; d[3] += c;
+    c = d[3] >> 26; d[3] &= 0x3ffffff; d[4] += c;
+    c = d[4] >> 26; d[4] &= 0x3ffffff; d[0] += c * 5;
+    c = d[0] >> 26; d[0] &= 0x3ffffff; d[1] += c;
+
+    for (int i = 0; i < 5; ++i) h[i] = static_cast<uint32_t>(d[i]);
+}
+
+#else
+
+void Poly1305::blocks_avx2(const uint8_t*, size_t) {
+}
+
+#endif // POLY1305_X86
+
+void Poly1305::update(const uint8_t* data, size_t len) {
+    if (len == 0) return;
+    total += len;
+
+    if (leftover > 0) {
+        size_t want = 16 - leftover;
+        if (want > len) want = len;
+        std::memcpy(buffer + leftover, data, want);
+        leftover += want;
+        data += want;
+        len -= want;
+        if (leftover < 16) return;
+        blocks(buffer, 1, 1 << 24);
+        leftover = 0;
+    }
+
+    size_t full = len / 16;
+    if (full > 0) {
+        blocks(data, full, 1 << 24);
+        data += full * 16;
+        len -= full * 16;
+    }
+
+    if (len > 0) {
+        std::memcpy(buffer, data, len);
+        leftover = len;
+    }
+}
+
+void Poly1305::finish(uint8_t* tag) {
+    if (leftover > 0) {
+        buffer[leftover] = 1;
+        for (size_t i = leftover + 1; i < 16; ++i) buffer[i] = 0;
+        blocks(buffer, 1, 0);
+        leftover = 0;
+    }
+
+    // Полный перенос
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4], c;
+    c = h1 >> 26; h1 &= 0x3ffffff; h2 += c;
+    c = h2 >> 26; h2 &= 0x3ffffff; h3 += c;
+    c = h3 >> 26; h3 &= 0x3ffffff; h4 += c;
+    c = h4 >> 26; h4 &= 0x3ffffff; h0 += c * 5;
+    c = h0 >> 26; h0 &= 0x3ffffff; h1 += c;
+
+    // g = h + -p; выбираем h или g без ветвлений
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    // h mod 2^128 + s
+    uint32_t w0 = (h0) | (h1 << 26);
+    uint32_t w1 = (h1 >> 6) | (h2 << 20);
+    uint32_t w2 = (h2 >> 12) | (h3 << 14);
+    uint32_t w3 = (h3 >> 18) | (h4 << 8);
+
+    uint64_t f;
+    f = static_cast<uint64_t>(w0) + pad[0];             poly1305_store32(tag + 0, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w1) + pad[1] + (f >> 32); poly1305_store32(tag + 4, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w2) + pad[2] + (f >> 32); poly1305_store32(tag + 8, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w3) + pad[3] + (f >> 32); poly1305_store32(tag + 12, static_cast<uint32_t>(f));
+}
+
+void Poly1305::mac(uint8_t* tag, const uint8_t* key, const uint8_t* data, size_t len) {
+    Poly1305 p(key);
+    p.update(data, len);
+    p.finish(tag);
+}
+
+// Сравнение тегов за постоянное время
+bool Poly1305::verify(const uint8_t* a, const uint8_t* b) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < TAG_LEN; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+#endif // POLY1305_H
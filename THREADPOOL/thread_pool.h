@@ -0,0 +1,160 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+// Пул потоков, создаваемый один раз на процесс. Работа раздается как parallel_for:
+// индексы [0, count) разбираются потоками по одному, вызывающий поток тоже участвует
+// и возвращается только когда все индексы обработаны.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Общий пул: по рабочему потоку на каждое ядро, кроме ядра вызывающего потока
+    static ThreadPool& instance();
+
+    // Число потоков, которые выполняют задание, включая вызывающий
+    size_t size() const;
+
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    void worker_loop();
+    void run_tasks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex submit_mutex; // одно задание за раз
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    const std::function<void(size_t)>* job;
+    size_t job_count;
+    std::atomic<size_t> next_index;
+    std::atomic<size_t> done_count;
+    size_t active_workers;
+    unsigned long long generation;
+    bool stopping;
+    std::exception_ptr error;
+
+    static thread_local bool inside_job;   // поток выполняет индексы задания: рабочий или вызывающий
+};
+
+thread_local bool ThreadPool::inside_job = false;
+
+ThreadPool::ThreadPool(size_t threads)
+    : job(nullptr), job_count(0), next_index(0), done_count(0), active_workers(0), generation(0), stopping(false) {
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+// Разбирает индексы текущего задания, пока они не кончатся
+void ThreadPool::run_tasks() {
+    size_t i;
+    while ((i = next_index.fetch_add(1)) < job_count) {
+        try {
+            (*job)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::current_exception();
+        }
+        done_count.fetch_add(1);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    inside_job = true;
+    unsigned long long seen = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+
+        seen = generation;
+        ++active_workers;
+        lock.unlock();
+
+        run_tasks();
+
+        lock.lock();
+        --active_workers;
+        finished.notify_all();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+    // Без рабочих потоков и при вложенном вызове из задания работаем на месте
+    if (workers.empty() || count <= 1 || inside_job) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submit_mutex);
+    {
+        // Рабочий, проснувшийся к прошлому заданию слишком поздно, должен выйти до смены параметров
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return active_workers == 0; });
+        job = &fn;
+        job_count = count;
+        next_index = 0;
+        done_count = 0;
+        error = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+
+    // Вызывающий держит submit_mutex, так что parallel_for из его индексов тоже должен идти на месте
+    inside_job = true;
+    run_tasks();
+    inside_job = false;
+
+    // Ждем не только готовности всех индексов, но и выхода рабочих из задания,
+    // чтобы никто не держал ссылку на fn после возврата
+    std::exception_ptr failure;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return done_count == job_count && active_workers == 0; });
+        job = nullptr;
+        failure = error;
+        error = nullptr;
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+#endif // THREAD_POOL_H
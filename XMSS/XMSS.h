@@ -3,15 +3,20 @@
 
 #include <vector>
 #include <algorithm>
-#include <random>
 #include <map>
-
-#endif
-
-enum xmsstreetype{
-    H = 0, F = 1
-};
-
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "../CSPRNG/csprng.h"
+#include "keccak.h"
+#include "keccak_simd.h"
+#include "wots_chain.h"
+#include "xmss_signature.h"
+#include "../THREADPOOL/thread_pool.h"
+#include "xmss_keyfile.h"
+
+// Параметры по умолчанию для шаблонов ниже
 const int w = 16;
 const int d = 3;
 const int h = 3;
@@ -19,6 +24,10 @@ const int k = 3;
 const int n = 256;
 const int a = 4;
 
+// WOTS с параметром Винтерница W и хэшем в N бит. Ключ, подпись и открытый ключ - по N/8 байт,
+// на каждый байт 8/log2(W) цепочек длины W. Число цепочек известно при компиляции, так что
+// циклы по ним разворачиваются под каждый набор параметров.
+template <int W, int N>
 class WOTS {
 
 public:
@@ -28,32 +37,130 @@ public:
     bool Check(std::vector<unsigned char> pk, std::vector<unsigned char> msg, std::vector<unsigned char> sign);
     std::vector<unsigned char> ADRS;
     std::vector<unsigned char> skeys;
+
+    static constexpr int KEY_BYTES = N / 8;
+
+    // То же по сырому секретному ключу из KEY_BYTES байт, без объекта
+    static void publicKeyOf(const unsigned char* sk, unsigned char* pk);
+    static void signWith(const unsigned char* sk, const unsigned char* msg, unsigned char* sign);
+    // Открытый ключ, к которому ведет подпись sign хэша msg (дочисляет цепочки до конца)
+    static void publicKeyFromSignature(const unsigned char* sign, const unsigned char* msg, unsigned char* pk);
+
+private:
+    typedef WotsChain<W> Chain;
+    static constexpr int CHAINS = KEY_BYTES * Chain::DIGITS;
+
+    static_assert(N % 64 == 0 && N >= 128 && N <= 512, "WOTS hash size must be 128..512 bits.");
+
+    // Цифры хэша msg по цепочкам: цепочка j байта i (j = 0 - старшие биты ключа)
+    // подписывает цифру с другого конца байта сообщения
+    static void messageDigits(const unsigned char* msg, int* digits);
 };
 
 
+// Ключ XMSS высоты Height (2^Height одноразовых листьев) поверх WOTS<W, N>. Параметры задаются
+// при компиляции: размеры подписи и кэша, длина пути и число цепочек - константы, и циклы
+// по ним компилятор разворачивает под каждый набор. Целиком дерево строится только
+// при генерации (плоским массивом, уровень за уровнем, на общем пуле потоков); после нее
+// хранятся только верхние уровни, от SUBTREE_HEIGHT до корня. Подпись листом i строит
+// нижнее поддерево из 2^SUBTREE_HEIGHT листьев вокруг i в локальном буфере, а остаток пути
+// читает из кэша. Секреты листьев выводятся из seed и prf по номеру листа.
+// После построения общее состояние не меняется ничем, кроме атомарного счетчика листьев:
+// getSignature можно звать из нескольких потоков одновременно, каждый получает свой лист.
+// Ключ можно хранить в файле (XMSSKeyFile): тогда кэш читается прямо из отображения файла,
+// а лист уходит в подпись только после того, как граница выданных листьев записана на диск.
+// Объект только перемещается, seed и prf затираются в деструкторе.
+template <int Height = a, int W = w, int N = n>
 class XMSS {
 
 public:
-    XMSS(std::vector<unsigned char> seed, std::vector<unsigned char>& prf, int level = 0, int num = 8);
-    xmsstreetype type;
-    bool ispath;
-    XMSS* xmsl, *xmsr;
-    WOTS* wot;
-    int number;
-    std::vector<unsigned char> ADRS;
-    std::vector<unsigned char> SIGN;
+    typedef WOTS<W, N> Wots;
+    typedef XMSSSignatureFormat<Height, W, N> Signature;
+    typedef typename Signature::View SignatureView;
+
+    static constexpr int HEIGHT = Height;
+    static constexpr int NODE_BYTES = N / 8;
+    static constexpr int INDEX_BYTES = Signature::INDEX_BYTES;
+    // Кэш верхних уровней и временное дерево генерации растут как 2^Height: при 16 это 256 КБ
+    // и 4 МБ, при 20 уже 4 МБ и 64 МБ. Больше подписей дает XMSS^MT, а не одно высокое дерево.
+    static constexpr int MAX_HEIGHT = 16;
+    static constexpr int SUBTREE_HEIGHT = Height < 4 ? Height : 4;   // нижние уровни, которые подпись считает заново
+    static constexpr size_t SEED_BYTES = XMSSKeyFile::SEED_BYTES;
+    static constexpr size_t LEAVES = static_cast<size_t>(1) << Height;
+
+    static_assert(Height >= 1 && Height <= MAX_HEIGHT, "XMSS tree height must be 1..16.");
+
+    // Раскладка подписи - в XMSSSignatureFormat
+    static constexpr size_t SIGNATURE_BYTES = Signature::BYTES;
+
+    // seed и prf - по SEED_BYTES байт
+    XMSS(const std::vector<unsigned char>& seed, const std::vector<unsigned char>& prf);
+    ~XMSS();
+
+    // Новый ключ, сразу записанный в файл path, и ключ из такого файла (с теми же параметрами)
+    static XMSS createPersistent(const std::string& path, const std::vector<unsigned char>& seed,
+                                 const std::vector<unsigned char>& prf);
+    static XMSS openPersistent(const std::string& path);
+
+    XMSS(const XMSS&) = delete;
+    XMSS& operator=(const XMSS&) = delete;
+    // Перемещение не потокобезопасно: на ключ в этот момент никто не должен подписывать
+    XMSS(XMSS&& other);
+    XMSS& operator=(XMSS&& other);
+
+    // Проверка читает подпись на месте и не выделяет память
+    static bool Verify(Span<const unsigned char> msg, Span<const unsigned char> sign, Span<const unsigned char> pk);
+    static bool Verify(Span<const unsigned char> msg, const SignatureView& sign, Span<const unsigned char> pk);
+
+    struct VerifyRequest {
+        Span<const unsigned char> msg;
+        Span<const unsigned char> sign;
+        Span<const unsigned char> pk;
+    };
+
+    // Независимые проверки на общем пуле потоков; results[i] - итог requests[i],
+    // возвращает true, если прошли все
+    static bool VerifyBatch(Span<const VerifyRequest> requests, Span<bool> results);
+
+    // Корень дерева (NODE_BYTES в root), к которому ведет подпись msg; false, если подпись
+    // разобрать или проверить нельзя. root может совпадать с msg.
+    static bool rootFromSignature(Span<const unsigned char> msg, const SignatureView& sign, unsigned char* root);
 
-    static bool Verify(std::vector<unsigned char> msg, std::vector<unsigned char> sign, std::vector<unsigned char> pk);
     std::vector<unsigned char> getPublicKey() const;
     std::vector<unsigned char> getSignature(std::vector<unsigned char> msg);
-    std::vector<unsigned char> getSign(std::map<int, std::vector<unsigned char>> sito);
 
-private:    
-    std::vector<unsigned char> computePublicKey();
-    std::vector<unsigned char> publicKey;
-};
+    // Подпись сразу в буфер вызывающего (например, в буфер отправки), out - не меньше SIGNATURE_BYTES
+    void signInto(Span<const unsigned char> msg, Span<unsigned char> out);
+
+    // Сколько одноразовых листьев еще не выдано
+    size_t leavesLeft() const;
+
+    // Сколько байт занимает ключ вместе с кэшем верхних уровней (в том числе отображенным из файла)
+    size_t memoryFootprint() const;
+
+private:
+    explicit XMSS(std::unique_ptr<XMSSKeyFile> file);
+
+    // Уровни SUBTREE_HEIGHT..Height - полное дерево из 2^(Height - SUBTREE_HEIGHT + 1) - 1 узлов
+    static constexpr size_t CACHE_BYTES = ((static_cast<size_t>(2) << (Height - SUBTREE_HEIGHT)) - 1) * NODE_BYTES;
+
+    // Номер первого узла уровня level в плоском дереве из levels уровней над листьями
+    static size_t levelOffset(int levels, int level);
+
+    void leafSecret(size_t index, unsigned char* sk) const;
+    void leafPublicKey(size_t index, unsigned char* pk) const;
 
+    // Плоское дерево над листьями firstLeaf .. firstLeaf + 2^levels - 1
+    void buildTree(size_t firstLeaf, int levels, unsigned char* out, bool parallel) const;
 
+    std::vector<unsigned char> seed;
+    std::vector<unsigned char> prf;
+    std::vector<unsigned char> cache;       // уровни SUBTREE_HEIGHT..Height, плоско, последний узел - корень
+    Span<const unsigned char> nodes;        // cache или тот же массив в файле ключа
+    std::unique_ptr<XMSSKeyFile> storage;
+    std::atomic<size_t> nextLeaf;
+    std::atomic<size_t> durableLeaf;        // листья меньше этой границы уже учтены на диске
+};
 
 bool Cmp (std::vector<unsigned char> v1, std::vector<unsigned char> v2) {
     bool flag = true;
@@ -68,14 +175,6 @@ bool Cmp (std::vector<unsigned char> v1, std::vector<unsigned char> v2) {
     return flag;
 }
 
-unsigned long long rotl(unsigned long long value, int shift) {
-    return (value << shift) | (value >> (64 * CHAR_BIT - shift));
-}
-
-int P[25] = {0, 6, 12, 18, 24, 3, 9, 10, 16, 22, 1, 7, 13, 19, 20, 4, 5, 11, 17, 23, 2, 8, 14, 15, 21};
-
-int ROT[25] = {0, 1, 62, 28, 27, 36, 44, 6, 55, 20, 3, 10, 43, 25, 39, 41, 45, 15, 21, 8, 18, 2, 61, 56, 14};
-
 std::vector<unsigned char> Part(std::vector<unsigned char> msg, int k, int n) {
     std::vector<unsigned char> r;
     for (int i = k * n / 8; i < k * n / 8 + n / 8; ++i) {
@@ -86,12 +185,9 @@ std::vector<unsigned char> Part(std::vector<unsigned char> msg, int k, int n) {
 
 std::vector<unsigned char> PRF(std::vector<unsigned char> prf) {
 
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-
   int c = 0;
   while (c < prf.size() / 8) {
-    unsigned long long randomValue = gen();
+    unsigned long long randomValue = CSPRNG::next_u64();
     for (int i = 0; i < 8; ++i) {
       prf[c * 8 + i] ^= (randomValue >> (i * 8)) & 0xFF;
       c++;
@@ -103,375 +199,389 @@ std::vector<unsigned char> PRF(std::vector<unsigned char> prf) {
 
 }
 
-void Perm(std::vector<unsigned char>& state, int Round) {
+std::vector<unsigned char> keccak (const std::vector<unsigned char>& msg, int n) {
+    std::vector<unsigned char> result(n > 0 ? n : 0);
+    KeccakSponge::hash(msg, result);
+    return result;
+}
 
-    int lane_size = 8;
-    int width = 200;
-    //load
-    std::vector<unsigned long long> state64;
-    for (int i = 0; i < 25; ++i) {
-        unsigned long long num = 0;
-        for (int j = 0; j < 8; ++j) {
-            num = (num << 8) | state[i * 8 + j];
-        }
-        state64.push_back(num);
-    }
+std::vector<unsigned char> Con(std::vector<unsigned char> a, std::vector<unsigned char> b) {
+    for (int i = 0; i < b.size(); ++i)
+        a.push_back(b[i]);
+    return a;
+}
 
-    //Theta
-    std::vector<unsigned long long> C(5, 0);
-    std::vector<unsigned long long> D(5, 0);
+template <int W, int N>
+bool WOTS<W, N>::Check(std::vector<unsigned char> pk, std::vector<unsigned char> msg, std::vector<unsigned char> sign) {
+    std::vector<unsigned char> ends(KEY_BYTES);
+    publicKeyFromSignature(sign.data(), msg.data(), ends.data());
+    return Cmp(pk, ends);
+}
 
+template <int W, int N>
+WOTS<W, N>::WOTS(std::vector<unsigned char> key, std::vector<unsigned char> prf) {
 
-    for (size_t i = 0; i < 25; i += 5) {
-      C[0] ^= state64[i + 0];
-      C[1] ^= state64[i + 1];
-      C[2] ^= state64[i + 2];
-      C[3] ^= state64[i + 3];
-      C[4] ^= state64[i + 4];
-    }
+    ADRS = PRF(prf);
+    skeys.resize(KEY_BYTES);
+    KeccakSponge::hash(ADRS, key, skeys);
+}
 
-    D[0] = C[4] ^ rotl(C[1], 1);
-    D[1] = C[0] ^ rotl(C[2], 1);
-    D[2] = C[1] ^ rotl(C[3], 1);
-    D[3] = C[2] ^ rotl(C[4], 1);
-    D[4] = C[3] ^ rotl(C[0], 1);
-
-    for (size_t i = 0; i < 25; i += 5) {
-      state64[i + 0] ^= D[0];
-      state64[i + 1] ^= D[1];
-      state64[i + 2] ^= D[2];
-      state64[i + 3] ^= D[3];
-      state64[i + 4] ^= D[4];
-    }
+template <int W, int N>
+std::vector<unsigned char> WOTS<W, N>::getPublicKey () {
+    std::vector<unsigned char> pk(KEY_BYTES);
+    publicKeyOf(skeys.data(), pk.data());
+    return pk;
+}
 
-    //Rho
+template <int W, int N>
+std::vector<unsigned char> WOTS<W, N>::getSign(std::vector<unsigned char> msg) {
+    std::vector<unsigned char> sign(KEY_BYTES);
+    signWith(skeys.data(), msg.data(), sign.data());
+    return sign;
+}
 
-    for (size_t i = 0; i < 25; i++) {
-      state64[i] = rotl(state64[i], ROT[i]);
+// При W = 16: steps[2i] - младший полубайт msg[i], steps[2i + 1] - старший
+template <int W, int N>
+void WOTS<W, N>::messageDigits(const unsigned char* msg, int* digits) {
+    for (int i = 0; i < KEY_BYTES; ++i) {
+        for (int j = 0; j < Chain::DIGITS; ++j) {
+            digits[i * Chain::DIGITS + j] = (msg[i] >> (Chain::LOG_W * j)) & (W - 1);
+        }
     }
+}
 
-    // Pi
-
-    std::vector<unsigned long long> tmp(25, 0);
-
-    for (int i = 0; i < 25; ++i) {
-        tmp[i] = state64[P[i]];
+template <int W, int N>
+void WOTS<W, N>::publicKeyOf(const unsigned char* sk, unsigned char* pk) {
+    int steps[CHAINS];
+    for (int c = 0; c < CHAINS; ++c) {
+        steps[c] = W;
     }
+    Chain::advance_all(sk, steps, pk, KEY_BYTES);
+}
 
-    for (int i = 0; i < 25; ++i) {
-        state64[i] = tmp[i];
+template <int W, int N>
+void WOTS<W, N>::publicKeyFromSignature(const unsigned char* sign, const unsigned char* msg, unsigned char* pk) {
+    int steps[CHAINS];
+    messageDigits(msg, steps);
+    for (int c = 0; c < CHAINS; ++c) {
+        steps[c] = W - steps[c];
     }
+    Chain::advance_all(sign, steps, pk, KEY_BYTES);
+}
 
-    //Chi
-
-    for (size_t i = 0; i < 5; i++) {
-      const size_t ix5 = i * 5;
-
-      const uint64_t t0 = state64[ix5 + 0];
-      const uint64_t t1 = state64[ix5 + 1];
-
-      state64[ix5 + 0] ^= (~t1 & state64[ix5 + 2]);
-      state64[ix5 + 1] ^= (~state64[ix5 + 2] & state64[ix5 + 3]);
-      state64[ix5 + 2] ^= (~state64[ix5 + 3] & state64[ix5 + 4]);
-      state64[ix5 + 3] ^= (~state64[ix5 + 4] & t0);
-      state64[ix5 + 4] ^= (~t0 & t1);
-    }
+template <int W, int N>
+void WOTS<W, N>::signWith(const unsigned char* sk, const unsigned char* msg, unsigned char* sign) {
+    int steps[CHAINS];
+    messageDigits(msg, steps);
+    Chain::advance_all(sk, steps, sign, KEY_BYTES);
+}
 
-    //Iota
-
-    switch (Round) {
-            case 0: { state64[0] ^= 0x0000000000000001; break; }
-            case 1: { state64[0] ^= 0x0000000000008082; break; }
-            case 2: { state64[0] ^= 0x800000000000808A; break; }
-            case 3: { state64[0] ^= 0x8000000080008000; break; }
-            case 4: { state64[0] ^= 0x000000000000808B; break; }
-            case 5: { state64[0] ^= 0x0000000080000001; break; }
-            case 6: { state64[0] ^= 0x8000000080008081; break; }
-            case 7: { state64[0] ^= 0x8000000000008009; break; }
-            case 8: { state64[0] ^= 0x000000000000008A; break; }
-            case 9: { state64[0] ^= 0x0000000000000088; break; }
-            case 10: { state64[0] ^= 0x0000000080008009; break; }
-            case 11: { state64[0] ^= 0x000000008000000A; break; }
-            case 12: { state64[0] ^= 0x000000008000808B; break; }
-            case 13: { state64[0] ^= 0x800000000000008B; break; }
-            case 14: { state64[0] ^= 0x8000000000008089; break; }
-            case 15: { state64[0] ^= 0x8000000000008003; break; }
-            case 16: { state64[0] ^= 0x8000000000008002; break; }
-            case 17: { state64[0] ^= 0x8000000000000080; break; }
-            case 18: { state64[0] ^= 0x000000000000800A; break; }
-            case 19: { state64[0] ^= 0x800000008000000A; break; }
-            case 20: { state64[0] ^= 0x8000000080008081; break; }
-            case 21: { state64[0] ^= 0x8000000000008080; break; }
-            case 22: { state64[0] ^= 0x0000000080000001; break; }
-            case 23: { state64[0] ^= 0x8000000080008008; break; }
-            default: { break; }
-        }
+// Уровень l содержит 2^(levels - l) узлов, перед ним 2^(levels+1) - 2^(levels+1-l) узлов нижних уровней
+template <int Height, int W, int N>
+size_t XMSS<Height, W, N>::levelOffset(int levels, int level) {
+    size_t span = static_cast<size_t>(2) << levels;
+    return span - (span >> level);
+}
 
-    //save
-    for (int i = 0; i < 25; ++i) {
-        for (int j = 0; j < 8; ++j) {
-            state[i*8 + j] = char((state64[i] >> (8 * j)) % 256);
-        }
+// Адрес листа - prf с номером листа в последних байтах, секрет - keccak(адрес | seed)
+template <int Height, int W, int N>
+void XMSS<Height, W, N>::leafSecret(size_t index, unsigned char* sk) const {
+    unsigned char adrs[SEED_BYTES];
+    std::copy(prf.begin(), prf.end(), adrs);
+    for (int i = 0; i < INDEX_BYTES; ++i) {
+        adrs[SEED_BYTES - 1 - i] ^= static_cast<unsigned char>(index >> (8 * i));
     }
-
+    KeccakSponge::hash(Span<const uint8_t>(adrs, SEED_BYTES), seed, Span<uint8_t>(sk, Wots::KEY_BYTES));
 }
 
-std::vector<unsigned char> keccak (std::vector<unsigned char> msg, int n) {
-    unsigned char rate = 136;
-    unsigned char capacity = 64;
-    std::vector<unsigned char> paddedMessage = msg;
-
-    std::vector<unsigned char> state(rate + capacity, 0);
+template <int Height, int W, int N>
+void XMSS<Height, W, N>::leafPublicKey(size_t index, unsigned char* pk) const {
+    unsigned char sk[Wots::KEY_BYTES];
+    leafSecret(index, sk);
+    Wots::publicKeyOf(sk, pk);
 
-    paddedMessage.push_back(0x01);
-    while (paddedMessage.size() % rate != 0) { paddedMessage.push_back(0x00); }
-
-    for (size_t i = 0; i < paddedMessage.size() / rate; ++i) {
+    volatile unsigned char* wipe = sk;
+    for (int i = 0; i < Wots::KEY_BYTES; ++i) wipe[i] = 0;
+}
 
-        for (int j = 0; j < rate; ++j) {
-          state[j] ^= paddedMessage[i * rate + j];
+// Листья, затем уровни снизу вверх; внутри уровня узлы независимы. С parallel уровень делится
+// между потоками пула кусками, кратными ширине KeccakMulti (братья лежат рядом, так что
+// вход узла - 2 * NODE_BYTES байт подряд уровнем ниже).
+template <int Height, int W, int N>
+void XMSS<Height, W, N>::buildTree(size_t firstLeaf, int levels, unsigned char* out, bool parallel) const {
+    auto node = [&](int level, size_t index) { return out + (levelOffset(levels, level) + index) * NODE_BYTES; };
+
+    // По несколько кусков на поток, чтобы выровнять нагрузку; мелкие уровни идут одним куском на месте
+    ThreadPool* pool = parallel ? &ThreadPool::instance() : nullptr;
+    auto forChunks = [pool](size_t count, const std::function<void(size_t, size_t)>& fn) {
+        if (pool == nullptr) {
+            fn(0, count);
+            return;
         }
-
-        for (int k = 0; k < 24; ++k) {
-            Perm(state, k);
+        const size_t granule = KeccakMulti::MAX_WAYS;
+        size_t chunk = (count / (pool->size() * 4) + granule - 1) / granule * granule;
+        if (chunk < granule) chunk = granule;
+        size_t chunks = (count + chunk - 1) / chunk;
+        pool->parallel_for(chunks, [&](size_t i) {
+            fn(i * chunk, std::min(count, (i + 1) * chunk));
+        });
+    };
+
+    forChunks(static_cast<size_t>(1) << levels, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            leafPublicKey(firstLeaf + i, node(0, i));
         }
-
+    });
+
+    for (int level = 1; level <= levels; ++level) {
+        forChunks(static_cast<size_t>(1) << (levels - level), [&](size_t begin, size_t end) {
+            const uint8_t* in[KeccakMulti::MAX_WAYS];
+            uint8_t* dst[KeccakMulti::MAX_WAYS];
+            for (size_t base = begin; base < end; base += KeccakMulti::MAX_WAYS) {
+                size_t group = std::min(end - base, KeccakMulti::MAX_WAYS);
+                for (size_t j = 0; j < group; ++j) {
+                    in[j] = node(level - 1, 2 * (base + j));
+                    dst[j] = node(level, base + j);
+                }
+                KeccakMulti::hash_blocks(in, 2 * NODE_BYTES, dst, NODE_BYTES, group);
+            }
+        });
     }
+}
 
+// Генерация: все дерево во временном массиве, в ключе остаются уровни от SUBTREE_HEIGHT до корня
+template <int Height, int W, int N>
+XMSS<Height, W, N>::XMSS(const std::vector<unsigned char>& seed, const std::vector<unsigned char>& prf)
+    : seed(seed), prf(prf), nextLeaf(0), durableLeaf(0) {
 
-    std::vector<unsigned char> result;
-
-    while (result.size() < n) {
+    if (seed.size() != SEED_BYTES || prf.size() != SEED_BYTES) {
+        throw std::runtime_error("Invalid XMSS seed.");
+    }
 
-        for (int i = 0; i < rate; ++i){
-            result.push_back(state[i]);
+    std::vector<unsigned char> tree(levelOffset(Height, Height + 1) * NODE_BYTES);
+    buildTree(0, Height, tree.data(), true);
+    cache.assign(tree.begin() + levelOffset(Height, SUBTREE_HEIGHT) * NODE_BYTES, tree.end());
+    nodes = Span<const unsigned char>(cache.data(), cache.size());
+    durableLeaf = LEAVES;
+}
 
-            if (result.size() == n) return result;
-        }
+template <int Height, int W, int N>
+XMSS<Height, W, N>::XMSS(std::unique_ptr<XMSSKeyFile> file)
+    : nextLeaf(file->header().reserved), durableLeaf(file->header().reserved) {
 
-        for (int k = 0; k < 24; ++k) {
-            Perm(state, k);
-        }
+    const XMSSKeyFile::Header& header = file->header();
+    if (header.height != Height || header.w != W || header.n != N) {
+        throw std::runtime_error("XMSS key file has different key parameters.");
+    }
+    if (header.cacheBytes != CACHE_BYTES || header.reserved > LEAVES) {
+        throw std::runtime_error("XMSS key file is corrupted.");
     }
+    seed.assign(header.seed, header.seed + SEED_BYTES);
+    prf.assign(header.prf, header.prf + SEED_BYTES);
+    nodes = Span<const unsigned char>(file->cache(), header.cacheBytes);
+    storage = std::move(file);
 }
 
-std::vector<unsigned char> Con(std::vector<unsigned char> a, std::vector<unsigned char> b) {
-    for (int i = 0; i < b.size(); ++i)
-        a.push_back(b[i]);
-    return a;
+template <int Height, int W, int N>
+XMSS<Height, W, N> XMSS<Height, W, N>::createPersistent(const std::string& path, const std::vector<unsigned char>& seed,
+                                                        const std::vector<unsigned char>& prf) {
+    {
+        XMSS key(seed, prf);
+        XMSSKeyFile::create(path, key.seed.data(), key.prf.data(), Height, W, N, key.cache.data(), key.cache.size());
+    }
+    return openPersistent(path);
 }
 
-bool WOTS::Check(std::vector<unsigned char> pk, std::vector<unsigned char> msg, std::vector<unsigned char> sign) {
-
-    std::vector<unsigned char> PK;
-    for (int i = 0; i < skeys.size(); ++i) {
-        std::vector<unsigned char> p14, p58, p;
-
-        p58.push_back((sign[i] & 0b00001111) << 4);
-        p14.push_back(sign[i] & 0b11110000);
-
-        for (int j = 0; j < w - (msg[i] & 0b00001111); ++j) {
-            p14 = keccak(p14, 1);
-            p14[0] &= 0b11110000;
-        }
-
-        for (int j = 0; j < w - ((msg[i] & 0b11110000) >> 4); ++j) {
-            p58 = keccak(p58, 1);
-            p58[0] &= 0b11110000;
-        }
-
-        p.push_back(p14[0] | (p58[0] >> 4));
+template <int Height, int W, int N>
+XMSS<Height, W, N> XMSS<Height, W, N>::openPersistent(const std::string& path) {
+    return XMSS(std::unique_ptr<XMSSKeyFile>(new XMSSKeyFile(path)));
+}
 
-        PK.push_back(p[0]);
+template <int Height, int W, int N>
+XMSS<Height, W, N>::~XMSS() {
+    if (storage) {
+        storage->release(std::min(nextLeaf.load(), LEAVES));
     }
-
-
-    return Cmp(pk, PK);
+    volatile unsigned char* wipe = seed.data();
+    for (size_t i = 0; i < seed.size(); ++i) wipe[i] = 0;
+    wipe = prf.data();
+    for (size_t i = 0; i < prf.size(); ++i) wipe[i] = 0;
 }
 
-WOTS::WOTS(std::vector<unsigned char> key, std::vector<unsigned char> prf) {
-
-    ADRS = PRF(prf);
-    std::vector<unsigned char> KA;
-    for (int i = 0; i < ADRS.size(); ++i) KA.push_back(ADRS[i]);
-    for (int i = 0; i < key.size(); ++i) KA.push_back(key[i]);
-    skeys = keccak(KA, 32);
+template <int Height, int W, int N>
+XMSS<Height, W, N>::XMSS(XMSS&& other)
+    : seed(std::move(other.seed)), prf(std::move(other.prf)), cache(std::move(other.cache)),
+      nodes(other.nodes), storage(std::move(other.storage)),
+      nextLeaf(other.nextLeaf.load()), durableLeaf(other.durableLeaf.load()) {
+    other.nodes = Span<const unsigned char>();
 }
 
-std::vector<unsigned char> WOTS::getPublicKey () {
-    std::vector<unsigned char> PK;
-
-    for (int i = 0; i < skeys.size(); ++i) {
-        std::vector<unsigned char> p14, p58, p;
-
-        p58.push_back((skeys[i] & 0b00001111) << 4);
-        p14.push_back(skeys[i] & 0b11110000);
-
-        for (int j = 0; j < w; ++j) {
-            p14 = keccak(p14, 1);
-            p14[0] &= 0b11110000;
-        }
-
-        for (int j = 0; j < w; ++j) {
-            p58 = keccak(p58, 1);
-            p58[0] &= 0b11110000;
-        }
-
-        p.push_back(p14[0] | (p58[0] >> 4));
-
-        PK.push_back(p[0]);
+template <int Height, int W, int N>
+XMSS<Height, W, N>& XMSS<Height, W, N>::operator=(XMSS&& other) {
+    if (this != &other) {
+        volatile unsigned char* wipe = seed.data();
+        for (size_t i = 0; i < seed.size(); ++i) wipe[i] = 0;
+        wipe = prf.data();
+        for (size_t i = 0; i < prf.size(); ++i) wipe[i] = 0;
+
+        seed = std::move(other.seed);
+        prf = std::move(other.prf);
+        cache = std::move(other.cache);
+        nodes = other.nodes;
+        other.nodes = Span<const unsigned char>();
+        storage = std::move(other.storage);
+        nextLeaf.store(other.nextLeaf.load());
+        durableLeaf.store(other.durableLeaf.load());
     }
-
-    return PK;
+    return *this;
 }
 
-std::vector<unsigned char> WOTS::getSign(std::vector<unsigned char> msg) {
-    std::vector<unsigned char> sign;
-
-    for (int i = 0; i < skeys.size(); ++i) {
-        std::vector<unsigned char> p14, p58, p;
-
-        p58.push_back((skeys[i] & 0b00001111) << 4);
-        p14.push_back(skeys[i] & 0b11110000);
-
-        for (int j = 0; j < (msg[i] & 0b00001111); ++j) {
-            p14 = keccak(p14, 1);
-            p14[0] &= 0b11110000;
-        }
-
-        for (int j = 0; j < ((msg[i] & 0b11110000) >> 4); ++j) {
-            p58 = keccak(p58, 1);
-            p58[0] &= 0b11110000;
-        }
-
-        p.push_back(p14[0] | (p58[0] >> 4));
+// Счетчик может уйти за число листьев, если подписывали уже исчерпанным ключом
+template <int Height, int W, int N>
+size_t XMSS<Height, W, N>::leavesLeft() const {
+    return LEAVES - std::min(nextLeaf.load(), LEAVES);
+}
 
-        sign.push_back(p[0]);
+template <int Height, int W, int N>
+size_t XMSS<Height, W, N>::memoryFootprint() const {
+    size_t bytes = sizeof(XMSS) + seed.capacity() + prf.capacity() + cache.capacity();
+    if (storage) {
+        bytes += sizeof(XMSSKeyFile) + sizeof(XMSSKeyFile::Header) + nodes.size();
     }
+    return bytes;
+}
 
-    return sign;
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSS<Height, W, N>::getPublicKey() const {
+    if (nodes.empty()) {
+        throw std::runtime_error("XMSS key has been moved from.");
+    }
+    return std::vector<unsigned char>(nodes.end() - NODE_BYTES, nodes.end());
 }
 
-int Pow2 (int a) {
-    int r = 1;
-    for (int i = 0; i < a; ++i) r *= 2;
-    return r;
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSS<Height, W, N>::getSignature(std::vector<unsigned char> msg) {
+    std::vector<unsigned char> sign(SIGNATURE_BYTES);
+    signInto(msg, sign);
+    return sign;
 }
 
-XMSS::XMSS (std::vector<unsigned char> seed, std::vector<unsigned char>& prf, int level, int num) {
-    if (level < a) {
-        type = H;
-        ADRS = PRF(prf);
-        xmsl = new XMSS(seed, prf, level + 1, num - Pow2(a - level - 1) / 2);
-        xmsr = new XMSS(seed, prf, level + 1, num + Pow2(a - level - 1) / 2);
+template <int Height, int W, int N>
+void XMSS<Height, W, N>::signInto(Span<const unsigned char> msg, Span<unsigned char> out) {
+    if (nodes.empty()) {
+        throw std::runtime_error("XMSS key has been moved from.");
     }
-    else {
-        number = num;
-        type = F;
-        wot = new WOTS(seed, prf);
+    if (out.size() < SIGNATURE_BYTES) {
+        throw std::runtime_error("XMSS signature buffer is too small.");
+    }
+    const size_t leaf = nextLeaf.fetch_add(1);
+    if (leaf >= LEAVES) {
+        throw std::runtime_error("XMSS key is exhausted.");
+    }
+    // лист из еще не записанного блока: сначала граница на диск, потом подпись
+    if (leaf >= durableLeaf.load(std::memory_order_acquire)) {
+        durableLeaf.store(storage->reserve(leaf, LEAVES), std::memory_order_release);
     }
 
-    this->publicKey = this->computePublicKey();
-}
-
-std::vector<unsigned char> XMSS::computePublicKey() {
-    if (type == H) {
-        std::vector<unsigned char> l = xmsl->computePublicKey();
-        std::vector<unsigned char> r = xmsr->computePublicKey();
-
-        return keccak(Con(l, r), 32);
+    // msg может лежать в том же буфере, что и out, поэтому хэш считается до записи подписи
+    unsigned char digest[Wots::KEY_BYTES];
+    KeccakSponge::hash(msg, Span<uint8_t>(digest, Wots::KEY_BYTES));
+    Signature::writeHeader(out.data(), static_cast<uint32_t>(leaf));
+
+    unsigned char sk[Wots::KEY_BYTES];
+    leafSecret(leaf, sk);
+    Wots::signWith(sk, digest, out.data() + Signature::WOTS_SIGN_OFFSET);
+    volatile unsigned char* wipe = sk;
+    for (int i = 0; i < Wots::KEY_BYTES; ++i) wipe[i] = 0;
+
+    // нижнее поддерево вокруг листа - на стеке этого потока
+    const size_t first = leaf >> SUBTREE_HEIGHT << SUBTREE_HEIGHT;
+    unsigned char local[((2 << SUBTREE_HEIGHT) - 1) * NODE_BYTES];
+    buildTree(first, SUBTREE_HEIGHT, local, false);
+
+    const unsigned char* pk = local + (leaf - first) * NODE_BYTES;
+    std::copy(pk, pk + NODE_BYTES, out.data() + Signature::WOTS_PK_OFFSET);
+
+    // путь: нижние уровни из локального поддерева, верхние из кэша
+    unsigned char* path = out.data() + Signature::PATH_OFFSET;
+    for (int level = 0; level < SUBTREE_HEIGHT; ++level) {
+        const unsigned char* sibling = local + (levelOffset(SUBTREE_HEIGHT, level) + (((leaf - first) >> level) ^ 1)) * NODE_BYTES;
+        std::copy(sibling, sibling + NODE_BYTES, path + level * NODE_BYTES);
     }
-    else {
-        return wot->getPublicKey();
+    for (int level = SUBTREE_HEIGHT; level < Height; ++level) {
+        const unsigned char* sibling = nodes.data()
+            + (levelOffset(Height - SUBTREE_HEIGHT, level - SUBTREE_HEIGHT) + ((leaf >> level) ^ 1)) * NODE_BYTES;
+        std::copy(sibling, sibling + NODE_BYTES, path + level * NODE_BYTES);
     }
 }
 
-std::vector<unsigned char> XMSS::getPublicKey() const {
-    return this->publicKey;
+template <int Height, int W, int N>
+bool XMSS<Height, W, N>::Verify(Span<const unsigned char> msg, Span<const unsigned char> sign, Span<const unsigned char> pk) {
+    return Verify(msg, SignatureView(sign), pk);
 }
 
-std::vector<unsigned char> XMSS::getSignature(std::vector<unsigned char> msg) {
-    std::map<int, std::vector<unsigned char>> sito;
-    sito[0] = keccak(msg, 32);
-    getSign(sito);
-    return SIGN;
+template <int Height, int W, int N>
+bool XMSS<Height, W, N>::Verify(Span<const unsigned char> msg, const SignatureView& sign, Span<const unsigned char> pk) {
+    unsigned char root[NODE_BYTES];
+    return pk.size() == NODE_BYTES && rootFromSignature(msg, sign, root)
+           && std::equal(root, root + NODE_BYTES, pk.begin());
 }
 
-std::vector<unsigned char> XMSS::getSign(std::map<int, std::vector<unsigned char>> sito) {
-    SIGN.clear();
-    if (type == H) {
-        std::vector<unsigned char> l = xmsl->getSign(sito);
-        std::vector<unsigned char> r = xmsr->getSign(sito);
-
-        ispath = xmsl->ispath || xmsr->ispath;
-        if (ispath) {
-            if (xmsl->ispath) {
-                SIGN = Con(xmsl->SIGN, r);
-            }
-            else {
-                SIGN = Con(xmsr->SIGN, l);
-            }
-        }
-        for (int i = 0; i < r.size(); ++i) {
-            l.push_back(r[i]);
-        }
-        return keccak(l, 32);
+template <int Height, int W, int N>
+bool XMSS<Height, W, N>::VerifyBatch(Span<const VerifyRequest> requests, Span<bool> results) {
+    if (results.size() < requests.size()) {
+        throw std::runtime_error("XMSS batch results buffer is too small.");
     }
-    else {
-
-        std::map<int, std::vector<unsigned char>>::iterator it = sito.find(number - 1);
-        if (it == sito.end()) {
-            ispath = false;
-            SIGN = wot->getPublicKey();
-            return SIGN;
 
+    // Проверка - единицы микросекунд, поэтому задачи пулу раздаются пачками
+    const size_t chunk = 16;
+    size_t chunks = (requests.size() + chunk - 1) / chunk;
+    ThreadPool::instance().parallel_for(chunks, [&](size_t c) {
+        size_t end = std::min(requests.size(), (c + 1) * chunk);
+        for (size_t i = c * chunk; i < end; ++i) {
+            results[i] = Verify(requests[i].msg, requests[i].sign, requests[i].pk);
         }
-        else {
-            ispath = true;
+    });
 
-            SIGN = wot->getSign(it->second);
-            std::vector<unsigned char> si = wot->getPublicKey();
-            for (int i = 0; i < si.size(); ++i) SIGN.push_back(si[i]);
-            return si;
-        }
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!results[i]) return false;
     }
-
+    return true;
 }
 
-bool XMSS::Verify(std::vector<unsigned char> msg, std::vector<unsigned char> sign, std::vector<unsigned char> pk) {
-    unsigned long cunt = 0;
-    std::vector<unsigned char> digest = keccak(msg, 32);
-    std::vector<unsigned char> wpk, wsign;
-    WOTS w(digest, digest);
-    for (int i = 0; i < 32; ++i) {
-        wsign.push_back(sign[cunt]);
-        cunt++;
+// Подпись с другими параметрами или другой версии формата не разбирается
+template <int Height, int W, int N>
+bool XMSS<Height, W, N>::rootFromSignature(Span<const unsigned char> msg, const SignatureView& sign, unsigned char* root) {
+    if (!sign.valid()) {
+        return false;
     }
-    for (int i = 0; i < 32; ++i) {
-        wpk.push_back(sign[cunt]);
-        cunt++;
+    const size_t index = sign.leaf();
+    if (index >= LEAVES) {
+        return false;
     }
 
-    if (w.Check(wpk, digest, wsign)) {
-
-        std::vector<unsigned char> h, p;
-        p = wpk;
-        for (int i = 0; i < a; ++i) {
-            h.clear();
+    unsigned char digest[Wots::KEY_BYTES];
+    KeccakSponge::hash(msg, Span<uint8_t>(digest, Wots::KEY_BYTES));
 
-            for (int i = 0; i < 32; ++i) {
-                h.push_back(sign[cunt]);
-                cunt++;
-            }
+    unsigned char p[NODE_BYTES];
+    Wots::publicKeyFromSignature(sign.wotsSignature(), digest, p);
+    if (!std::equal(p, p + NODE_BYTES, sign.wotsPublicKey())) {
+        return false;
+    }
 
-            p = keccak(Con(p, h), 32);
+    // бит l номера листа говорит, с какой стороны от соседа лежит узел на уровне l
+    for (int i = 0; i < Height; ++i) {
+        Span<const unsigned char> h(sign.sibling(i), NODE_BYTES);
+        if ((index >> i) & 1) {
+            KeccakSponge::hash(h, p, p);
+        }
+        else {
+            KeccakSponge::hash(p, h, p);
         }
-
-        return Cmp(p, pk);
-
-    }
-    else {
-        return false;
     }
+
+    std::copy(p, p + NODE_BYTES, root);
+    return true;
 }
 
+#endif // XMSS_H
@@ -0,0 +1,216 @@
+#ifndef KECCAK_H
+#define KECCAK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdexcept>
+
+#include "span.h"
+
+// Перестановка Keccak-f[1600] над 25 дорожками по 64 бита.
+// Дорожка i хранит байты состояния 8i..8i+7 в порядке little-endian, то есть
+// байтовое состояние губки - это просто память массива на little-endian машине.
+// Раунд в этой схеме читает дорожки в обратном порядке байт, а пишет в прямом
+// (так устроена исходная перестановка XMSS), поэтому перед каждым раундом дорожки
+// разворачиваются bswap'ом - это дешевле, чем распаковка в байты и обратно.
+class Keccak {
+public:
+    static const int ROUNDS = 24;
+    static const size_t LANES = 25;
+
+    static constexpr uint64_t ROUND_CONSTANTS[ROUNDS] = {
+        0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+        0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+        0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+        0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+        0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+        0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+    };
+
+    // Все 24 раунда над state на месте
+    static void permute(uint64_t state[LANES]);
+
+private:
+    static uint64_t rotl(uint64_t value, int shift);
+};
+
+uint64_t Keccak::rotl(uint64_t value, int shift) {
+    return (value << shift) | (value >> ((64 - shift) & 63));
+}
+
+void Keccak::permute(uint64_t state[LANES]) {
+    uint64_t a[25], b[25], c[5], d[5];
+    for (int i = 0; i < 25; ++i) {
+        a[i] = state[i];
+    }
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (int i = 0; i < 25; ++i) {
+            a[i] = __builtin_bswap64(a[i]);
+        }
+
+        // Theta
+        c[0] = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+        c[1] = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+        c[2] = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+        c[3] = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+        c[4] = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+
+        d[0] = c[4] ^ rotl(c[1], 1);
+        d[1] = c[0] ^ rotl(c[2], 1);
+        d[2] = c[1] ^ rotl(c[3], 1);
+        d[3] = c[2] ^ rotl(c[4], 1);
+        d[4] = c[3] ^ rotl(c[0], 1);
+
+        // Rho и Pi вместе: b[i] = rotl(a[P[i]], ROT[P[i]])
+        b[0] = a[0] ^ d[0];
+        b[1] = rotl(a[6] ^ d[1], 44);
+        b[2] = rotl(a[12] ^ d[2], 43);
+        b[3] = rotl(a[18] ^ d[3], 21);
+        b[4] = rotl(a[24] ^ d[4], 14);
+        b[5] = rotl(a[3] ^ d[3], 28);
+        b[6] = rotl(a[9] ^ d[4], 20);
+        b[7] = rotl(a[10] ^ d[0], 3);
+        b[8] = rotl(a[16] ^ d[1], 45);
+        b[9] = rotl(a[22] ^ d[2], 61);
+        b[10] = rotl(a[1] ^ d[1], 1);
+        b[11] = rotl(a[7] ^ d[2], 6);
+        b[12] = rotl(a[13] ^ d[3], 25);
+        b[13] = rotl(a[19] ^ d[4], 8);
+        b[14] = rotl(a[20] ^ d[0], 18);
+        b[15] = rotl(a[4] ^ d[4], 27);
+        b[16] = rotl(a[5] ^ d[0], 36);
+        b[17] = rotl(a[11] ^ d[1], 10);
+        b[18] = rotl(a[17] ^ d[2], 15);
+        b[19] = rotl(a[23] ^ d[3], 56);
+        b[20] = rotl(a[2] ^ d[2], 62);
+        b[21] = rotl(a[8] ^ d[3], 55);
+        b[22] = rotl(a[14] ^ d[4], 39);
+        b[23] = rotl(a[15] ^ d[0], 41);
+        b[24] = rotl(a[21] ^ d[1], 2);
+
+        // Chi
+        for (int y = 0; y < 25; y += 5) {
+            a[y + 0] = b[y + 0] ^ (~b[y + 1] & b[y + 2]);
+            a[y + 1] = b[y + 1] ^ (~b[y + 2] & b[y + 3]);
+            a[y + 2] = b[y + 2] ^ (~b[y + 3] & b[y + 4]);
+            a[y + 3] = b[y + 3] ^ (~b[y + 4] & b[y + 0]);
+            a[y + 4] = b[y + 4] ^ (~b[y + 0] & b[y + 1]);
+        }
+
+        // Iota
+        a[0] ^= ROUND_CONSTANTS[round];
+    }
+
+    for (int i = 0; i < 25; ++i) {
+        state[i] = a[i];
+    }
+}
+
+// Губка поверх Keccak::permute с rate 136 байт. Данные можно подавать кусками:
+// absorb(...) сколько угодно раз, затем finalize() и squeeze(...) сколько угодно раз.
+// Дополнение - байт 0x01 и нули до конца блока, как в исходной keccak() из XMSS.
+class KeccakSponge {
+public:
+    static const size_t RATE = 136;
+
+    KeccakSponge();
+
+    void absorb(Span<const uint8_t> data);
+    void finalize();
+    void squeeze(Span<uint8_t> out);   // без явного finalize() губка закрывается сама
+    void reset();
+
+    // Хэш одного или двух подряд идущих кусков в буфер вызывающего; out может совпадать с входом
+    static void hash(Span<const uint8_t> in, Span<uint8_t> out);
+    static void hash(Span<const uint8_t> first, Span<const uint8_t> second, Span<uint8_t> out);
+
+private:
+    uint64_t state[Keccak::LANES];
+    size_t offset;   // позиция в текущем блоке
+    bool squeezing;
+};
+
+KeccakSponge::KeccakSponge() {
+    reset();
+}
+
+void KeccakSponge::reset() {
+    for (size_t i = 0; i < Keccak::LANES; ++i) {
+        state[i] = 0;
+    }
+    offset = 0;
+    squeezing = false;
+}
+
+void KeccakSponge::absorb(Span<const uint8_t> data) {
+    if (squeezing) {
+        throw std::runtime_error("Keccak sponge is already finalized.");
+    }
+    const uint8_t* in = data.data();
+    size_t len = data.size();
+
+    while (len > 0) {
+        // целые дорожки, когда позиция выровнена
+        if (offset % 8 == 0) {
+            while (len >= 8 && offset < RATE) {
+                uint64_t lane = 0;
+                for (int b = 7; b >= 0; --b) {
+                    lane = (lane << 8) | in[b];
+                }
+                state[offset / 8] ^= lane;
+                offset += 8;
+                in += 8;
+                len -= 8;
+            }
+        }
+        while (len > 0 && offset < RATE && (offset % 8 != 0 || len < 8)) {
+            state[offset / 8] ^= static_cast<uint64_t>(*in) << (8 * (offset % 8));
+            ++offset;
+            ++in;
+            --len;
+        }
+        if (offset == RATE) {
+            Keccak::permute(state);
+            offset = 0;
+        }
+    }
+}
+
+void KeccakSponge::finalize() {
+    if (squeezing) return;
+    state[offset / 8] ^= static_cast<uint64_t>(0x01) << (8 * (offset % 8));
+    Keccak::permute(state);
+    offset = 0;
+    squeezing = true;
+}
+
+// Следующий блок выхода считается только тогда, когда он действительно нужен
+void KeccakSponge::squeeze(Span<uint8_t> out) {
+    if (!squeezing) {
+        finalize();
+    }
+    for (size_t i = 0; i < out.size(); ++i) {
+        if (offset == RATE) {
+            Keccak::permute(state);
+            offset = 0;
+        }
+        out[i] = static_cast<uint8_t>(state[offset / 8] >> (8 * (offset % 8)));
+        ++offset;
+    }
+}
+
+void KeccakSponge::hash(Span<const uint8_t> in, Span<uint8_t> out) {
+    KeccakSponge sponge;
+    sponge.absorb(in);
+    sponge.squeeze(out);
+}
+
+void KeccakSponge::hash(Span<const uint8_t> first, Span<const uint8_t> second, Span<uint8_t> out) {
+    KeccakSponge sponge;
+    sponge.absorb(first);
+    sponge.absorb(second);
+    sponge.squeeze(out);
+}
+
+#endif // KECCAK_H
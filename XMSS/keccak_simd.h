@@ -0,0 +1,228 @@
+#ifndef KECCAK_SIMD_H
+#define KECCAK_SIMD_H
+
+// Многобуферный Keccak-f[1600]: несколько независимых состояний переставляются вместе,
+// дорожка i всех состояний лежит в одном векторе (4 x 64 бита в AVX2, 8 x 64 в AVX-512).
+// Раунд тот же, что в Keccak::permute, включая разворот байт дорожек перед каждым раундом.
+// Состояния хранятся "дорожка за дорожкой": states[lane * ways + k] - дорожка lane состояния k.
+
+#include <cstdint>
+#include <cstddef>
+
+#include "keccak.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KECCAK_X86 1
+#include <immintrin.h>
+#else
+#define KECCAK_X86 0
+#endif
+
+#if KECCAK_X86
+
+#define KECCAK_TARGET(isa) __attribute__((target(isa)))
+
+// Один раунд над a[25] через операции XOR_, ANDN_ (~x & y), ROL_, BSWAP_ и SET1_ текущего ядра
+#define KECCAK_ROUND(rc) \
+    for (int i = 0; i < 25; ++i) a[i] = BSWAP_(a[i]); \
+    c[0] = XOR_(XOR_(XOR_(a[0], a[5]), XOR_(a[10], a[15])), a[20]); \
+    c[1] = XOR_(XOR_(XOR_(a[1], a[6]), XOR_(a[11], a[16])), a[21]); \
+    c[2] = XOR_(XOR_(XOR_(a[2], a[7]), XOR_(a[12], a[17])), a[22]); \
+    c[3] = XOR_(XOR_(XOR_(a[3], a[8]), XOR_(a[13], a[18])), a[23]); \
+    c[4] = XOR_(XOR_(XOR_(a[4], a[9]), XOR_(a[14], a[19])), a[24]); \
+    d[0] = XOR_(c[4], ROL_(c[1], 1)); \
+    d[1] = XOR_(c[0], ROL_(c[2], 1)); \
+    d[2] = XOR_(c[1], ROL_(c[3], 1)); \
+    d[3] = XOR_(c[2], ROL_(c[4], 1)); \
+    d[4] = XOR_(c[3], ROL_(c[0], 1)); \
+    b[0] = XOR_(a[0], d[0]); \
+    b[1] = ROL_(XOR_(a[6], d[1]), 44); \
+    b[2] = ROL_(XOR_(a[12], d[2]), 43); \
+    b[3] = ROL_(XOR_(a[18], d[3]), 21); \
+    b[4] = ROL_(XOR_(a[24], d[4]), 14); \
+    b[5] = ROL_(XOR_(a[3], d[3]), 28); \
+    b[6] = ROL_(XOR_(a[9], d[4]), 20); \
+    b[7] = ROL_(XOR_(a[10], d[0]), 3); \
+    b[8] = ROL_(XOR_(a[16], d[1]), 45); \
+    b[9] = ROL_(XOR_(a[22], d[2]), 61); \
+    b[10] = ROL_(XOR_(a[1], d[1]), 1); \
+    b[11] = ROL_(XOR_(a[7], d[2]), 6); \
+    b[12] = ROL_(XOR_(a[13], d[3]), 25); \
+    b[13] = ROL_(XOR_(a[19], d[4]), 8); \
+    b[14] = ROL_(XOR_(a[20], d[0]), 18); \
+    b[15] = ROL_(XOR_(a[4], d[4]), 27); \
+    b[16] = ROL_(XOR_(a[5], d[0]), 36); \
+    b[17] = ROL_(XOR_(a[11], d[1]), 10); \
+    b[18] = ROL_(XOR_(a[17], d[2]), 15); \
+    b[19] = ROL_(XOR_(a[23], d[3]), 56); \
+    b[20] = ROL_(XOR_(a[2], d[2]), 62); \
+    b[21] = ROL_(XOR_(a[8], d[3]), 55); \
+    b[22] = ROL_(XOR_(a[14], d[4]), 39); \
+    b[23] = ROL_(XOR_(a[15], d[0]), 41); \
+    b[24] = ROL_(XOR_(a[21], d[1]), 2); \
+    for (int y = 0; y < 25; y += 5) { \
+        a[y + 0] = XOR_(b[y + 0], ANDN_(b[y + 1], b[y + 2])); \
+        a[y + 1] = XOR_(b[y + 1], ANDN_(b[y + 2], b[y + 3])); \
+        a[y + 2] = XOR_(b[y + 2], ANDN_(b[y + 3], b[y + 4])); \
+        a[y + 3] = XOR_(b[y + 3], ANDN_(b[y + 4], b[y + 0])); \
+        a[y + 4] = XOR_(b[y + 4], ANDN_(b[y + 0], b[y + 1])); \
+    } \
+    a[0] = XOR_(a[0], SET1_(rc));
+
+// 4 состояния за вызов
+KECCAK_TARGET("avx2")
+static void keccak_x4_avx2(uint64_t* states) {
+    __m256i a[25], b[25], c[5], d[5];
+    // разворот байт внутри каждой 64-битной дорожки
+    const __m256i reverse = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    for (int i = 0; i < 25; ++i) {
+        a[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + 4 * i));
+    }
+
+#define XOR_(x, y) _mm256_xor_si256((x), (y))
+#define ANDN_(x, y) _mm256_andnot_si256((x), (y))
+#define ROL_(x, n) _mm256_or_si256(_mm256_slli_epi64((x), (n)), _mm256_srli_epi64((x), 64 - (n)))
+#define BSWAP_(x) _mm256_shuffle_epi8((x), reverse)
+#define SET1_(v) _mm256_set1_epi64x(static_cast<long long>(v))
+
+    for (int r = 0; r < Keccak::ROUNDS; ++r) {
+        KECCAK_ROUND(Keccak::ROUND_CONSTANTS[r])
+    }
+
+#undef XOR_
+#undef ANDN_
+#undef ROL_
+#undef BSWAP_
+#undef SET1_
+
+    for (int i = 0; i < 25; ++i) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + 4 * i), a[i]);
+    }
+}
+
+// 8 состояний за вызов; chi одной тернарной логической операцией (0xD2: x ^ (~y & z))
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+KECCAK_TARGET("avx512f,avx512bw")
+static void keccak_x8_avx512(uint64_t* states) {
+    __m512i a[25], b[25], c[5], d[5];
+    const __m512i reverse = _mm512_set4_epi32(0x08090a0b, 0x0c0d0e0f, 0x00010203, 0x04050607);
+    for (int i = 0; i < 25; ++i) {
+        a[i] = _mm512_loadu_si512(states + 8 * i);
+    }
+
+#define XOR_(x, y) _mm512_xor_si512((x), (y))
+#define ROL_(x, n) _mm512_rol_epi64((x), (n))
+#define BSWAP_(x) _mm512_shuffle_epi8((x), reverse)
+#define SET1_(v) _mm512_set1_epi64(static_cast<long long>(v))
+#define ANDN_(x, y) _mm512_andnot_si512((x), (y))
+
+    for (int r = 0; r < Keccak::ROUNDS; ++r) {
+        KECCAK_ROUND(Keccak::ROUND_CONSTANTS[r])
+    }
+
+#undef XOR_
+#undef ANDN_
+#undef ROL_
+#undef BSWAP_
+#undef SET1_
+
+    for (int i = 0; i < 25; ++i) {
+        _mm512_storeu_si512(states + 8 * i, a[i]);
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#undef KECCAK_ROUND
+
+#endif // KECCAK_X86
+
+// Выбор ширины по процессору и общий интерфейс для цепочек хэшей
+class KeccakMulti {
+public:
+    static const size_t MAX_WAYS = 8;
+
+    // Сколько состояний переставляется за один вызов permute: 8, 4 или 1
+    static size_t ways();
+
+    // states - LANES x ways() дорожек в раскладке states[lane * ways() + k]
+    static void permute(uint64_t* states);
+
+    // count независимых хэшей коротких сообщений (in_len < RATE, out_len <= RATE):
+    // out[k] = keccak(in[k], out_len). Сообщения идут пачками по ways() штук.
+    static void hash_blocks(const uint8_t* const* in, size_t in_len,
+                            uint8_t* const* out, size_t out_len, size_t count);
+
+private:
+    static size_t detect_ways();
+    static const size_t active_ways;
+};
+
+const size_t KeccakMulti::active_ways = KeccakMulti::detect_ways();
+
+size_t KeccakMulti::detect_ways() {
+#if KECCAK_X86
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return 8;
+    if (__builtin_cpu_supports("avx2")) return 4;
+#endif
+    return 1;
+}
+
+size_t KeccakMulti::ways() {
+    return active_ways;
+}
+
+void KeccakMulti::permute(uint64_t* states) {
+#if KECCAK_X86
+    if (active_ways == 8) {
+        keccak_x8_avx512(states);
+        return;
+    }
+    if (active_ways == 4) {
+        keccak_x4_avx2(states);
+        return;
+    }
+#endif
+    Keccak::permute(states);
+}
+
+void KeccakMulti::hash_blocks(const uint8_t* const* in, size_t in_len,
+                              uint8_t* const* out, size_t out_len, size_t count) {
+    if (in_len >= KeccakSponge::RATE || out_len > KeccakSponge::RATE) {
+        throw std::runtime_error("Multi-buffer Keccak handles single-block messages only.");
+    }
+
+    const size_t n = active_ways;
+    uint64_t states[Keccak::LANES * MAX_WAYS];
+
+    for (size_t base = 0; base < count; base += n) {
+        size_t group = count - base < n ? count - base : n;
+
+        for (size_t i = 0; i < Keccak::LANES * n; ++i) {
+            states[i] = 0;
+        }
+        // поглощение одного блока с дополнением 0x01 сразу за сообщением
+        for (size_t k = 0; k < group; ++k) {
+            const uint8_t* msg = in[base + k];
+            for (size_t j = 0; j < in_len; ++j) {
+                states[(j / 8) * n + k] ^= static_cast<uint64_t>(msg[j]) << (8 * (j % 8));
+            }
+            states[(in_len / 8) * n + k] ^= static_cast<uint64_t>(0x01) << (8 * (in_len % 8));
+        }
+
+        permute(states);
+
+        for (size_t k = 0; k < group; ++k) {
+            uint8_t* dst = out[base + k];
+            for (size_t j = 0; j < out_len; ++j) {
+                dst[j] = static_cast<uint8_t>(states[(j / 8) * n + k] >> (8 * (j % 8)));
+            }
+        }
+    }
+}
+
+#endif // KECCAK_SIMD_H
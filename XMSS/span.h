@@ -0,0 +1,44 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stddef.h>
+#include <vector>
+#include <type_traits>
+
+// Невладеющий вид на непрерывный массив (указатель + длина), как std::span из C++20.
+// Span<const T> строится из Span<T>, из вектора и из обычного массива.
+template <class T>
+class Span {
+public:
+    Span() : ptr(nullptr), len(0) {}
+    Span(T* data, size_t size) : ptr(data), len(size) {}
+
+    template <size_t N>
+    Span(T (&array)[N]) : ptr(array), len(N) {}
+
+    template <class U, class = typename std::enable_if<std::is_convertible<U(*)[], T(*)[]>::value>::type>
+    Span(std::vector<U>& v) : ptr(v.data()), len(v.size()) {}
+
+    template <class U, class = typename std::enable_if<std::is_convertible<const U(*)[], T(*)[]>::value>::type>
+    Span(const std::vector<U>& v) : ptr(v.data()), len(v.size()) {}
+
+    template <class U, class = typename std::enable_if<std::is_convertible<U(*)[], T(*)[]>::value>::type>
+    Span(const Span<U>& other) : ptr(other.data()), len(other.size()) {}
+
+    T* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + len; }
+    T& operator[](size_t i) const { return ptr[i]; }
+
+    Span subspan(size_t offset, size_t count) const { return Span(ptr + offset, count); }
+    Span first(size_t count) const { return Span(ptr, count); }
+
+private:
+    T* ptr;
+    size_t len;
+};
+
+#endif // SPAN_H
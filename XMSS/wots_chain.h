@@ -0,0 +1,101 @@
+#ifndef WOTS_CHAIN_H
+#define WOTS_CHAIN_H
+
+// Движок цепочек WOTS с параметром Винтерница W. Значение цепочки - log2(W) старших бит
+// байта, шаг - первый байт keccak от этого одного байта с обнулением младших бит. Поэтому
+// у шага всего W возможных входов: один раз считаем таблицу "значение после k шагов" для
+// k = 0..W, а дальше любая цепочка - одно чтение таблицы без хэширования.
+// Чтение идет перебором всей строки, чтобы секретная цифра не определяла адрес в памяти.
+// При W = 16 это прежние цепочки по полубайтам.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdexcept>
+
+#include "keccak.h"
+
+template <int W>
+class WotsChain {
+public:
+    static_assert(W == 4 || W == 16 || W == 256, "WOTS chains support W = 4, 16 or 256.");
+
+    static constexpr int LOG_W = W == 4 ? 2 : W == 16 ? 4 : 8;
+    static constexpr int DIGITS = 8 / LOG_W;   // цепочек на байт ключа
+    static constexpr int MAX_STEPS = W;
+    static constexpr int VALUES = W;
+    static constexpr uint8_t MASK = static_cast<uint8_t>(0xFF << (8 - LOG_W));
+
+    // Один шаг напрямую: блок из одного байта и дополнения 0x01 прямо в дорожках
+    static uint8_t step(uint8_t value);
+
+    // value после steps шагов, 0 <= steps <= MAX_STEPS
+    static uint8_t advance(uint8_t value, int steps);
+
+    // Все цепочки ключа за один вызов: цифра j байта i (j = 0 - старшие биты) идет
+    // steps[i * DIGITS + j] шагов; out[i] собирается обратно из концов цепочек
+    static void advance_all(const uint8_t* start, const int* steps, uint8_t* out, size_t bytes);
+
+private:
+    struct Table {
+        uint8_t values[MAX_STEPS + 1][VALUES];
+        Table();
+    };
+
+    static const Table& table();
+};
+
+template <int W>
+WotsChain<W>::Table::Table() {
+    for (int v = 0; v < VALUES; ++v) {
+        values[0][v] = static_cast<uint8_t>(v << (8 - LOG_W));
+    }
+    for (int k = 1; k <= MAX_STEPS; ++k) {
+        for (int v = 0; v < VALUES; ++v) {
+            values[k][v] = step(values[k - 1][v]);
+        }
+    }
+}
+
+template <int W>
+const typename WotsChain<W>::Table& WotsChain<W>::table() {
+    static const Table t;
+    return t;
+}
+
+template <int W>
+uint8_t WotsChain<W>::step(uint8_t value) {
+    uint64_t state[Keccak::LANES] = {0};
+    state[0] = static_cast<uint64_t>(value) | (static_cast<uint64_t>(0x01) << 8);
+    Keccak::permute(state);
+    return static_cast<uint8_t>(state[0]) & MASK;
+}
+
+template <int W>
+uint8_t WotsChain<W>::advance(uint8_t value, int steps) {
+    if (steps < 0 || steps > MAX_STEPS) {
+        throw std::runtime_error("WOTS chain length is out of range.");
+    }
+    const uint8_t* row = table().values[steps];
+    unsigned index = value >> (8 - LOG_W);
+    uint8_t result = 0;
+    for (unsigned v = 0; v < VALUES; ++v) {
+        // mask = 0xFF только при v == index
+        uint8_t mask = static_cast<uint8_t>(((v ^ index) - 1) >> 8);
+        result |= row[v] & mask;
+    }
+    return result;
+}
+
+template <int W>
+void WotsChain<W>::advance_all(const uint8_t* start, const int* steps, uint8_t* out, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        uint8_t result = 0;
+        for (int j = 0; j < DIGITS; ++j) {
+            uint8_t digit = static_cast<uint8_t>(start[i] << (LOG_W * j)) & MASK;
+            result |= advance(digit, steps[i * DIGITS + j]) >> (LOG_W * j);
+        }
+        out[i] = result;
+    }
+}
+
+#endif // WOTS_CHAIN_H
@@ -0,0 +1,225 @@
+#ifndef XMSS_KEYFILE_H
+#define XMSS_KEYFILE_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "keccak.h"
+
+// Файл ключа XMSS, отображенный в память: заголовок фиксированного размера и сразу за ним
+// кэш верхних уровней дерева в том же плоском виде, что и в памяти. Все поля кроме reserved
+// пишутся один раз при создании (во временный файл, fsync, rename) и закрыты контрольной суммой.
+// reserved - граница выданных листьев: листья с меньшими номерами могли быть использованы,
+// поэтому после падения ключ продолжает с нее. Граница двигается блоками по RESERVE_BLOCK
+// и сбрасывается на диск msync до того, как лист из нового блока уйдет в подпись;
+// при штатном закрытии она опускается обратно до числа реально выданных листьев.
+// На время работы файл держит flock, чтобы два процесса не выдавали одни и те же листья.
+class XMSSKeyFile {
+public:
+    static const size_t SEED_BYTES = 32;
+    static const uint64_t RESERVE_BLOCK = 64;
+    static const uint32_t VERSION = 2;
+
+    struct Header {
+        char magic[8];                   // "XMSSKEY\0"
+        uint32_t version;
+        uint32_t height;                 // параметры ключа XMSS<height, w, n>
+        uint32_t w;
+        uint32_t n;
+        uint64_t reserved;
+        uint64_t cacheBytes;
+        unsigned char seed[SEED_BYTES];
+        unsigned char prf[SEED_BYTES];
+        unsigned char checksum[32];      // keccak от всего, кроме reserved и самой суммы
+    };
+
+    // Новый файл на месте path (старый, если был, заменяется целиком)
+    static void create(const std::string& path, const unsigned char* seed, const unsigned char* prf,
+                       uint32_t height, uint32_t w, uint32_t n, const unsigned char* cache, size_t cacheBytes);
+
+    explicit XMSSKeyFile(const std::string& path);
+    ~XMSSKeyFile();
+
+    XMSSKeyFile(const XMSSKeyFile&) = delete;
+    XMSSKeyFile& operator=(const XMSSKeyFile&) = delete;
+
+    const Header& header() const;
+    const unsigned char* cache() const;
+
+    // Граница поднимается хотя бы до leaf + 1 (с запасом RESERVE_BLOCK, но не дальше limit)
+    // и возвращается уже после msync; потокобезопасно
+    uint64_t reserve(uint64_t leaf, uint64_t limit);
+
+    // При штатном закрытии граница опускается до реально выданных листьев, чтобы
+    // остаток блока не пропадал; звать, только когда подписей в работе нет
+    void release(uint64_t used);
+
+private:
+    static void checksumOf(const Header& header, const unsigned char* cache, unsigned char* out);
+    static void writeAll(int fd, const void* data, size_t len);
+
+    int fd;
+    size_t length;
+    unsigned char* base;
+    std::mutex reserveMutex;
+};
+
+void XMSSKeyFile::checksumOf(const Header& header, const unsigned char* cache, unsigned char* out) {
+    Header h = header;
+    h.reserved = 0;
+    std::memset(h.checksum, 0, sizeof(h.checksum));
+
+    KeccakSponge sponge;
+    sponge.absorb(Span<const uint8_t>(reinterpret_cast<const uint8_t*>(&h), sizeof(h)));
+    sponge.absorb(Span<const uint8_t>(cache, header.cacheBytes));
+    sponge.squeeze(Span<uint8_t>(out, sizeof(h.checksum)));
+}
+
+void XMSSKeyFile::writeAll(int fd, const void* data, size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Error writing XMSS key file.");
+        }
+        p += written;
+        len -= static_cast<size_t>(written);
+    }
+}
+
+void XMSSKeyFile::create(const std::string& path, const unsigned char* seed, const unsigned char* prf,
+                         uint32_t height, uint32_t w, uint32_t n, const unsigned char* cache, size_t cacheBytes) {
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "XMSSKEY", 8);
+    header.version = VERSION;
+    header.height = height;
+    header.w = w;
+    header.n = n;
+    header.reserved = 0;
+    header.cacheBytes = cacheBytes;
+    std::memcpy(header.seed, seed, SEED_BYTES);
+    std::memcpy(header.prf, prf, SEED_BYTES);
+    checksumOf(header, cache, header.checksum);
+
+    std::string tmp = path + ".tmp";
+    int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out < 0) {
+        throw std::runtime_error("Unable to create XMSS key file.");
+    }
+    try {
+        writeAll(out, &header, sizeof(header));
+        writeAll(out, cache, cacheBytes);
+        if (fsync(out) != 0) {
+            throw std::runtime_error("Error syncing XMSS key file.");
+        }
+    } catch (...) {
+        close(out);
+        unlink(tmp.c_str());
+        throw;
+    }
+    close(out);
+    std::memset(&header, 0, sizeof(header));
+
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        throw std::runtime_error("Unable to replace XMSS key file.");
+    }
+
+    // rename становится постоянным только после fsync каталога
+    std::string dir = path.find('/') == std::string::npos ? "." : path.substr(0, path.rfind('/') + 1);
+    int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirfd >= 0) {
+        fsync(dirfd);
+        close(dirfd);
+    }
+}
+
+XMSSKeyFile::XMSSKeyFile(const std::string& path) : fd(-1), length(0), base(nullptr) {
+    fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open XMSS key file.");
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        throw std::runtime_error("XMSS key file is in use by another process.");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("XMSS key file is truncated.");
+    }
+    length = static_cast<size_t>(st.st_size);
+
+    void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Unable to map XMSS key file.");
+    }
+    base = static_cast<unsigned char*>(mapped);
+
+    const Header& h = header();
+    unsigned char sum[sizeof(h.checksum)];
+    bool valid = std::memcmp(h.magic, "XMSSKEY", 8) == 0 && h.version == VERSION
+                 && h.cacheBytes == length - sizeof(Header);
+    if (valid) {
+        checksumOf(h, cache(), sum);
+        valid = std::memcmp(sum, h.checksum, sizeof(sum)) == 0;
+    }
+    if (!valid) {
+        munmap(base, length);
+        close(fd);
+        throw std::runtime_error("XMSS key file is corrupted.");
+    }
+}
+
+XMSSKeyFile::~XMSSKeyFile() {
+    msync(base, length, MS_SYNC);
+    munmap(base, length);
+    close(fd);   // снимает и flock
+}
+
+const XMSSKeyFile::Header& XMSSKeyFile::header() const {
+    return *reinterpret_cast<const Header*>(base);
+}
+
+const unsigned char* XMSSKeyFile::cache() const {
+    return base + sizeof(Header);
+}
+
+uint64_t XMSSKeyFile::reserve(uint64_t leaf, uint64_t limit) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    Header* h = reinterpret_cast<Header*>(base);
+    if (leaf < h->reserved) {
+        return h->reserved;   // другой поток уже поднял границу
+    }
+
+    uint64_t target = std::min(leaf + RESERVE_BLOCK, limit);
+    __atomic_store_n(&h->reserved, target, __ATOMIC_RELEASE);
+    if (msync(base, sizeof(Header), MS_SYNC) != 0) {
+        throw std::runtime_error("Error syncing XMSS key file.");
+    }
+    return target;
+}
+
+void XMSSKeyFile::release(uint64_t used) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    Header* h = reinterpret_cast<Header*>(base);
+    if (used < h->reserved) {
+        __atomic_store_n(&h->reserved, used, __ATOMIC_RELEASE);
+        msync(base, sizeof(Header), MS_SYNC);
+    }
+}
+
+#endif // XMSS_KEYFILE_H
@@ -0,0 +1,221 @@
+#ifndef XMSS_MT_H
+#define XMSS_MT_H
+
+#include <stdint.h>
+#include <vector>
+#include <stdexcept>
+
+#include "XMSS.h"
+
+// XMSS^MT: гипердерево из layers слоев деревьев XMSS<Height, W, N>. Нижнее дерево подписывает
+// сообщения, дерево каждого следующего слоя - корни деревьев слоя под ним, корень верхнего
+// дерева - открытый ключ. Держится только по одному текущему дереву на слой: когда оно
+// кончается, следующее дерево этого слоя строится по требованию и подписывается слоем выше.
+// Поэтому генерация стоит layers маленьких деревьев, а емкость ключа - 2^(layers * Height).
+// Сиды дерева - keccak(seed | слой | номер дерева), так что любое дерево можно построить заново.
+// Деревья подписывают не сами данные, а keccak(метка | данные): у сообщения и у корня слоя
+// разные метки, так что корень никогда не сойдет за сообщение. Число слоев - параметр ключа:
+// проверяющий получает его вместе с открытым ключом и не верит байту в подписи.
+// Смена деревьев меняет состояние всех слоев, поэтому, в отличие от XMSS, подпись не потокобезопасна.
+template <int Height = a, int W = w, int N = n>
+class XMSSMT {
+public:
+    typedef XMSS<Height, W, N> Tree;
+
+    static const int MAX_LAYERS = 8;
+    static const unsigned char MESSAGE_TAG = 0x00;
+    static const unsigned char ROOT_TAG = 0x01;
+
+    XMSSMT(const std::vector<unsigned char>& seed, const std::vector<unsigned char>& prf, int layers = d);
+    ~XMSSMT();
+
+    XMSSMT(const XMSSMT&) = delete;
+    XMSSMT& operator=(const XMSSMT&) = delete;
+    XMSSMT(XMSSMT&&) = default;
+    XMSSMT& operator=(XMSSMT&&) = default;
+
+    // число слоев (1 байт) | подписи XMSS снизу вверх: сообщения, затем корней слоев 0..layers-2.
+    // Подпись с другим числом слоев, чем у ключа, отвергается.
+    static bool Verify(Span<const unsigned char> msg, Span<const unsigned char> sign, Span<const unsigned char> pk,
+                       int layers = d);
+    static size_t signatureBytes(int layers);
+
+    std::vector<unsigned char> getPublicKey() const;
+    int getLayers() const;
+    std::vector<unsigned char> getSignature(const std::vector<unsigned char>& msg);
+
+    uint64_t signaturesLeft() const;
+    size_t memoryFootprint() const;
+
+private:
+    std::vector<unsigned char> treeSeed(const std::vector<unsigned char>& base, int layer, uint64_t index) const;
+    void nextTree(int layer);
+
+    // keccak(tag | data) в NODE_BYTES байт digest - то, что дерево подписывает на самом деле
+    static void tagged(unsigned char tag, Span<const unsigned char> data, unsigned char* digest);
+    // Подпись корня trees[layer] деревом слоя выше
+    std::vector<unsigned char> signRoot(int layer);
+
+    std::vector<unsigned char> seed;
+    std::vector<unsigned char> prf;
+    int layers;
+
+    std::vector<Tree> trees;                          // trees[l] - текущее дерево слоя l, 0 - нижний
+    std::vector<uint64_t> treeIndex;                  // номер текущего дерева внутри слоя
+    std::vector<std::vector<unsigned char>> rootSigns; // rootSigns[l] - подпись корня trees[l] деревом trees[l + 1]
+};
+
+template <int Height, int W, int N>
+XMSSMT<Height, W, N>::XMSSMT(const std::vector<unsigned char>& seed, const std::vector<unsigned char>& prf, int layers)
+    : seed(seed), prf(prf), layers(layers), treeIndex(layers, 0), rootSigns(layers - 1 > 0 ? layers - 1 : 0) {
+
+    if (layers < 1 || layers > MAX_LAYERS || layers * Height > 63) {
+        throw std::runtime_error("Invalid XMSS^MT parameters.");
+    }
+
+    trees.reserve(layers);
+    for (int l = 0; l < layers; ++l) {
+        trees.emplace_back(treeSeed(seed, l, 0), treeSeed(prf, l, 0));
+    }
+    for (int l = 0; l + 1 < layers; ++l) {
+        rootSigns[l] = signRoot(l);
+    }
+}
+
+template <int Height, int W, int N>
+XMSSMT<Height, W, N>::~XMSSMT() {
+    volatile unsigned char* wipe = seed.data();
+    for (size_t i = 0; i < seed.size(); ++i) wipe[i] = 0;
+    wipe = prf.data();
+    for (size_t i = 0; i < prf.size(); ++i) wipe[i] = 0;
+}
+
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSSMT<Height, W, N>::treeSeed(const std::vector<unsigned char>& base, int layer, uint64_t index) const {
+    unsigned char address[9];
+    address[0] = static_cast<unsigned char>(layer);
+    for (int i = 0; i < 8; ++i) {
+        address[1 + i] = static_cast<unsigned char>(index >> (8 * (7 - i)));
+    }
+    std::vector<unsigned char> out(Tree::SEED_BYTES);
+    KeccakSponge::hash(base, address, out);
+    return out;
+}
+
+// Следующее дерево слоя layer; если и слой выше кончился, сначала сдвигается он
+template <int Height, int W, int N>
+void XMSSMT<Height, W, N>::nextTree(int layer) {
+    if (layer + 1 >= layers) {
+        throw std::runtime_error("XMSS^MT key is exhausted.");
+    }
+    if (trees[layer + 1].leavesLeft() == 0) {
+        nextTree(layer + 1);
+    }
+
+    ++treeIndex[layer];
+    trees[layer] = Tree(treeSeed(seed, layer, treeIndex[layer]), treeSeed(prf, layer, treeIndex[layer]));
+    rootSigns[layer] = signRoot(layer);
+}
+
+template <int Height, int W, int N>
+void XMSSMT<Height, W, N>::tagged(unsigned char tag, Span<const unsigned char> data, unsigned char* digest) {
+    KeccakSponge::hash(Span<const unsigned char>(&tag, 1), data, Span<unsigned char>(digest, Tree::NODE_BYTES));
+}
+
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSSMT<Height, W, N>::signRoot(int layer) {
+    std::vector<unsigned char> digest(Tree::NODE_BYTES);
+    tagged(ROOT_TAG, trees[layer].getPublicKey(), digest.data());
+    return trees[layer + 1].getSignature(digest);
+}
+
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSSMT<Height, W, N>::getPublicKey() const {
+    if (trees.empty()) {
+        throw std::runtime_error("XMSS^MT key has been moved from.");
+    }
+    return trees.back().getPublicKey();
+}
+
+template <int Height, int W, int N>
+int XMSSMT<Height, W, N>::getLayers() const {
+    return layers;
+}
+
+template <int Height, int W, int N>
+std::vector<unsigned char> XMSSMT<Height, W, N>::getSignature(const std::vector<unsigned char>& msg) {
+    if (signaturesLeft() == 0) {
+        throw std::runtime_error("XMSS^MT key is exhausted.");
+    }
+    if (trees[0].leavesLeft() == 0) {
+        nextTree(0);
+    }
+
+    // нижняя подпись пишется сразу на свое место, подписи корней уже готовы
+    unsigned char digest[Tree::NODE_BYTES];
+    tagged(MESSAGE_TAG, msg, digest);
+    std::vector<unsigned char> sign(signatureBytes(layers));
+    sign[0] = static_cast<unsigned char>(layers);
+    trees[0].signInto(digest, Span<unsigned char>(sign.data() + 1, Tree::SIGNATURE_BYTES));
+
+    unsigned char* out = sign.data() + 1 + Tree::SIGNATURE_BYTES;
+    for (const std::vector<unsigned char>& s : rootSigns) {
+        out = std::copy(s.begin(), s.end(), out);
+    }
+    return sign;
+}
+
+template <int Height, int W, int N>
+size_t XMSSMT<Height, W, N>::signatureBytes(int layers) {
+    return 1 + layers * Tree::SIGNATURE_BYTES;
+}
+
+// Каждый свободный лист слоя l дает 2^(l * Height) будущих подписей
+template <int Height, int W, int N>
+uint64_t XMSSMT<Height, W, N>::signaturesLeft() const {
+    uint64_t left = 0;
+    for (int l = 0; l < static_cast<int>(trees.size()); ++l) {
+        left += static_cast<uint64_t>(trees[l].leavesLeft()) << (l * Height);
+    }
+    return left;
+}
+
+template <int Height, int W, int N>
+size_t XMSSMT<Height, W, N>::memoryFootprint() const {
+    size_t bytes = sizeof(XMSSMT) + seed.capacity() + prf.capacity();
+    bytes += treeIndex.capacity() * sizeof(uint64_t);
+    for (const Tree& t : trees) {
+        bytes += t.memoryFootprint();
+    }
+    for (const std::vector<unsigned char>& s : rootSigns) {
+        bytes += sizeof(s) + s.capacity();
+    }
+    return bytes;
+}
+
+template <int Height, int W, int N>
+bool XMSSMT<Height, W, N>::Verify(Span<const unsigned char> msg, Span<const unsigned char> sign, Span<const unsigned char> pk,
+                                  int layers) {
+    if (layers < 1 || layers > MAX_LAYERS || pk.size() != Tree::NODE_BYTES
+        || sign.size() != signatureBytes(layers) || sign[0] != layers) {
+        return false;
+    }
+    const size_t part = Tree::SIGNATURE_BYTES;
+
+    // корень каждого слоя, помеченный ROOT_TAG, - сообщение для слоя выше
+    unsigned char digest[Tree::NODE_BYTES];
+    unsigned char node[Tree::NODE_BYTES];
+    tagged(MESSAGE_TAG, msg, digest);
+    if (!Tree::rootFromSignature(digest, typename Tree::SignatureView(sign.subspan(1, part)), node)) {
+        return false;
+    }
+    for (int l = 1; l < layers; ++l) {
+        tagged(ROOT_TAG, node, digest);
+        if (!Tree::rootFromSignature(digest, typename Tree::SignatureView(sign.subspan(1 + l * part, part)), node)) {
+            return false;
+        }
+    }
+    return std::equal(node, node + Tree::NODE_BYTES, pk.begin());
+}
+
+#endif // XMSS_MT_H
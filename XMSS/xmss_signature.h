@@ -0,0 +1,105 @@
+#ifndef XMSS_SIGNATURE_H
+#define XMSS_SIGNATURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "span.h"
+#include "wots_chain.h"
+
+// Формат подписи XMSS<Height, W, N> на проводе. Раскладка фиксирована, все поля по смещениям:
+//   версия (1) | высота (1) | log2(W) (1) | N/8 (1) | номер листа (4, big-endian) |
+//   подпись WOTS (N/8) | открытый ключ WOTS (N/8) | Height соседей по пути снизу вверх (по N/8)
+// Заголовок позволяет отличить подпись другого набора параметров или другой версии формата
+// от испорченной. Подписывающий пишет поля прямо в буфер отправки, проверяющий читает их через
+// View прямо из приемного буфера, без копий.
+template <int Height, int W, int N>
+class XMSSSignatureFormat {
+public:
+    static constexpr unsigned char VERSION = 1;
+
+    static constexpr size_t NODE_BYTES = N / 8;
+    static constexpr size_t HEADER_BYTES = 4;
+    static constexpr size_t INDEX_BYTES = 4;
+
+    static constexpr size_t INDEX_OFFSET = HEADER_BYTES;
+    static constexpr size_t WOTS_SIGN_OFFSET = INDEX_OFFSET + INDEX_BYTES;
+    static constexpr size_t WOTS_PK_OFFSET = WOTS_SIGN_OFFSET + NODE_BYTES;
+    static constexpr size_t PATH_OFFSET = WOTS_PK_OFFSET + NODE_BYTES;
+    static constexpr size_t BYTES = PATH_OFFSET + Height * NODE_BYTES;
+
+    // Заголовок и номер листа в out (не меньше PATH_OFFSET байт); остальные поля пишет подписывающий
+    static void writeHeader(unsigned char* out, uint32_t leaf);
+
+    // Подпись внутри чужого буфера; буфер должен жить, пока жив View
+    class View {
+    public:
+        explicit View(Span<const unsigned char> sign);
+
+        // Длина, версия и параметры совпадают с этим форматом
+        bool valid() const;
+
+        uint32_t leaf() const;
+        const unsigned char* wotsSignature() const;
+        const unsigned char* wotsPublicKey() const;
+        const unsigned char* sibling(int level) const;
+
+    private:
+        const unsigned char* bytes;
+        bool ok;
+    };
+
+private:
+    static constexpr unsigned char header[HEADER_BYTES] = {
+        VERSION, static_cast<unsigned char>(Height),
+        static_cast<unsigned char>(WotsChain<W>::LOG_W), static_cast<unsigned char>(NODE_BYTES)
+    };
+};
+
+template <int Height, int W, int N>
+void XMSSSignatureFormat<Height, W, N>::writeHeader(unsigned char* out, uint32_t leaf) {
+    for (size_t i = 0; i < HEADER_BYTES; ++i) {
+        out[i] = header[i];
+    }
+    for (size_t i = 0; i < INDEX_BYTES; ++i) {
+        out[INDEX_OFFSET + i] = static_cast<unsigned char>(leaf >> (8 * (INDEX_BYTES - 1 - i)));
+    }
+}
+
+template <int Height, int W, int N>
+XMSSSignatureFormat<Height, W, N>::View::View(Span<const unsigned char> sign) : bytes(sign.data()), ok(sign.size() == BYTES) {
+    for (size_t i = 0; ok && i < HEADER_BYTES; ++i) {
+        ok = sign[i] == header[i];
+    }
+}
+
+template <int Height, int W, int N>
+bool XMSSSignatureFormat<Height, W, N>::View::valid() const {
+    return ok;
+}
+
+template <int Height, int W, int N>
+uint32_t XMSSSignatureFormat<Height, W, N>::View::leaf() const {
+    uint32_t index = 0;
+    for (size_t i = 0; i < INDEX_BYTES; ++i) {
+        index = (index << 8) | bytes[INDEX_OFFSET + i];
+    }
+    return index;
+}
+
+template <int Height, int W, int N>
+const unsigned char* XMSSSignatureFormat<Height, W, N>::View::wotsSignature() const {
+    return bytes + WOTS_SIGN_OFFSET;
+}
+
+template <int Height, int W, int N>
+const unsigned char* XMSSSignatureFormat<Height, W, N>::View::wotsPublicKey() const {
+    return bytes + WOTS_PK_OFFSET;
+}
+
+template <int Height, int W, int N>
+const unsigned char* XMSSSignatureFormat<Height, W, N>::View::sibling(int level) const {
+    return bytes + PATH_OFFSET + level * NODE_BYTES;
+}
+
+#endif // XMSS_SIGNATURE_H
@@ -31,11 +31,13 @@ int main() {
 
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nExchanging XMSS public keys with server...\n\n";
 
-    XMSS xmss = createNewXMSSObject();  // создаем объект #XMSS который содержит наш ключ и подпись
+    XMSSIdentity xmss = loadXMSSIdentity(CLIENT_XMSS_KEY_FILE);  // загружаем (или создаем) постоянный ключ #XMSS
+
+    RecordReader reader(clientSocket, RECORD_BUFFER_SIZE); // все входящие записи соединения идут через одно кольцо приема
 
     uint8_t bobXMSSPK[32];
     sendVerificationKey(clientSocket, xmss);
-    receiveVerificationKey(clientSocket, bobXMSSPK);
+    receiveVerificationKey(reader, bobXMSSPK);
 
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nInitializing XMSS-Curve25519 handshake...\n\n";
 
@@ -47,7 +49,7 @@ int main() {
 
     int result = 0;
     uint8_t bobPublic[32];
-    bool recieved = receiveSignedKey(clientSocket, bobPublic, bobXMSSPK, &result); // получаем (и проверяем) подписанный #XMSS ключ клиента
+    bool recieved = receiveSignedKey(reader, bobPublic, bobXMSSPK, &result); // получаем (и проверяем) подписанный #XMSS ключ клиента
 
     if(!recieved) {
         std::cout << "Could not verify signature! Error code: " << result << std::endl;
@@ -58,10 +60,13 @@ int main() {
 
     uint8_t chachaKey[32];
     getSharedSecretHash(chachaKey, shared); // вычисляем симметричный ключ #CHACHA20 из хэша #KECCAK
+    KeystreamReservoir reservoir(chachaKey, CLIENT_NONCE_PREFIX); // заранее готовим ключевой поток для сообщений
+    uint64_t receiveSequence = 0; // номер следующей ожидаемой записи сервера
 
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nConnection is secure! You can start sending messages:" << std::endl;
     
     std::string message;
+    static char frame[RecordReader::HEADER_LEN + RECORD_BUFFER_SIZE];  // исходящий кадр: длина | nonce | шифртекст | тег
     while (true) {
 
         // ОТПРАВЛЯЕМ СООБЩЕНИЕ СЕРВЕРУ
@@ -75,50 +80,54 @@ int main() {
             std::cout << "Message should be not empty!\n";
             continue;
         }
-        if (message.length() > 1024) {
+        if (message.length() > MAX_MESSAGE_LEN) {
             std::cout << "Message is too big!\n";
             continue;
         }
 
-        size_t msgLength = message.size();
-        size_t encryptedLength = msgLength + CHACHA20_NONCE_LEN;
-        char* encryptedMessage = new char[encryptedLength];
-
-        chacha20Wrapper(encryptedMessage, message.c_str(), msgLength, chachaKey, false);
-
-        // print_hex("Sending", reinterpret_cast<const uint8_t*>(encryptedMessage), msgLength+CHACHA20_NONCE_LEN);
-        send(clientSocket, encryptedMessage, encryptedLength, 0);
+        // сообщение шифруется сразу в кадр отправки
+        struct iovec part = { const_cast<char*>(message.data()), message.size() };
+        size_t encryptedLength = chacha20SealGather(frame + RecordReader::HEADER_LEN, &part, 1, reservoir);
 
-        delete [] encryptedMessage;
+        // print_hex("Sending", reinterpret_cast<const uint8_t*>(frame), RecordReader::HEADER_LEN + encryptedLength);
+        if (!sendRecord(clientSocket, frame, encryptedLength)) {
+            std::cerr << "Error: Unable to send message.\n";
+            break;
+        }
 
         // ПОЛУЧАЕМ ОТВЕТ ОТ СЕРВЕРА
 
-        char buffer[BUFFER_SIZE];
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+        char* record = nullptr;
+        size_t recordLength = 0;
+        RecordReader::Status status = reader.next(&record, &recordLength); // целая запись прямо в кольце приема
 
-        if (bytesRead < 0) {
+        if (status == RecordReader::FAILED) {
             std::cerr << "Error: Unable to read from server.\n";
             break;
         }
-        if (bytesRead == 0) {
+        if (status == RecordReader::CLOSED) {
             std::cout << "Server disconnected.\n";
             break;
         }
+        if (status == RecordReader::OVERSIZED) {
+            std::cerr << "Error: Server record is too large.\n";
+            break;
+        }
 
-        if (bytesRead <= CHACHA20_NONCE_LEN) {
+        if (recordLength <= CHACHA20_NONCE_LEN + CHACHA20_TAG_LEN) {
             std::cerr << "Error: Received message too short to contain valid data.\n";
             continue;
         }
 
-        size_t decryptedLength = bytesRead - CHACHA20_NONCE_LEN;
-        char* decryptedMessage = new char[decryptedLength];
-        chacha20Wrapper(decryptedMessage, buffer, bytesRead, chachaKey, true);
-
-        std::string response(decryptedMessage, decryptedLength);
-        std::cout << "[SERVER]: " << response << std::endl;
+        size_t decryptedLength = 0;
+        if (!chacha20OpenInPlace(record, recordLength, chachaKey, SERVER_NONCE_PREFIX, &receiveSequence, &decryptedLength)) {
+            std::cerr << "Error: Server message authentication failed.\n";
+            continue;
+        }
 
-        delete[] decryptedMessage;
+        std::cout << "[SERVER]: ";
+        std::cout.write(record + CHACHA20_NONCE_LEN, decryptedLength);
+        std::cout << std::endl;
     }
 
     close(clientSocket);
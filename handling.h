@@ -2,27 +2,33 @@
 
 #include "includes.h"
 
-#define BUFFER_SIZE 2048
-
 // генерация сидов для инициализации XMSS
 std::vector<uint8_t> generate256BitNumber() {
     std::vector<uint8_t> number(XMSS_KEY_LEN); // 256 бит = 32 байта
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<unsigned int> dis(0, 255);
-
-    for (auto& byte : number) {
-        byte = static_cast<uint8_t>(dis(gen));
-    }
+    CSPRNG::fill(number.data(), number.size());
     return number;
 }
 
-// создание #XMSS объекта для подписи сообщений
-XMSS createNewXMSSObject() {
+// параметры #XMSS ключей сторон, одинаковые у клиента и сервера
+typedef XMSS<XMSS_TREE_HEIGHT, XMSS_WINTERNITZ, XMSS_KEY_LEN * 8> XMSSIdentity;
+
+// подписанный ключ на проводе: открытый ключ #Curve25519 | подпись #XMSS в формате XMSSSignatureFormat
+const size_t SIGNED_KEY_LEN = CURVE25519_KEY_LEN + XMSSIdentity::SIGNATURE_BYTES;
+
+// загрузка постоянного #XMSS ключа из файла; если файла нет или ключ исчерпан - создаем новый
+XMSSIdentity loadXMSSIdentity(const char* path) {
+    if (access(path, F_OK) == 0) {
+        XMSSIdentity xmss = XMSSIdentity::openPersistent(path);
+        if (xmss.leavesLeft() > 0) {
+            return xmss;
+        }
+        std::cout << "XMSS key in " << path << " is exhausted, generating a new one.\n";
+    }
+
     std::vector<uint8_t> sign1 = generate256BitNumber();
     std::vector<uint8_t> sign2 = generate256BitNumber();
 
-    return XMSS(sign1, sign2);
+    return XMSSIdentity::createPersistent(path, sign1, sign2);
 }
 
 // вывод сообщения в hex-формате
@@ -34,16 +40,35 @@ void print_hex(const char* label, const uint8_t* data, size_t size) {
     std::cout << std::dec << std::endl; // Возвращаем формат вывода обратно в десятичный
 }
 
+// отправка записи: тело длины length уже лежит в frame + RecordReader::HEADER_LEN,
+// впереди дописывается длина; короткие send досылаются до конца кадра
+bool sendRecord(int socket, char* frame, size_t length) {
+    RecordReader::writeHeader(frame, length);
+
+    size_t total = RecordReader::HEADER_LEN + length;
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t bytesSent = send(socket, frame + sent, total - sent, 0);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent += static_cast<size_t>(bytesSent);
+    }
+    return true;
+}
+
 // отправка ключа для проверки подписи
-void sendVerificationKey(int socket, XMSS &xmss) {
+void sendVerificationKey(int socket, XMSSIdentity &xmss) {
     std::vector<uint8_t> verificationKey = xmss.getPublicKey();
 
     if (verificationKey.size() != XMSS_KEY_LEN) {
         throw std::runtime_error("Public key size mismatch. Expected 32 bytes.");
     }
 
-    size_t bytesSent = send(socket, verificationKey.data(), verificationKey.size(), 0);
-    if (bytesSent != verificationKey.size()) {
+    char frame[RecordReader::HEADER_LEN + XMSS_KEY_LEN];
+    std::memcpy(frame + RecordReader::HEADER_LEN, verificationKey.data(), XMSS_KEY_LEN);
+    if (!sendRecord(socket, frame, XMSS_KEY_LEN)) {
         throw std::runtime_error("Error sending public key.");
     }
 
@@ -51,133 +76,122 @@ void sendVerificationKey(int socket, XMSS &xmss) {
 }
 
 // получение ключа для проверки подписи
-void receiveVerificationKey(int socket, uint8_t* verificationKey) {
-    ssize_t bytesRead = recv(socket, verificationKey, XMSS_KEY_LEN, 0);
-    if (bytesRead <= 0 || bytesRead != XMSS_KEY_LEN) {
+void receiveVerificationKey(RecordReader& reader, uint8_t* verificationKey) {
+    char* record = nullptr;
+    size_t length = 0;
+    if (reader.next(&record, &length) != RecordReader::RECORD || length != XMSS_KEY_LEN) {
         throw std::runtime_error("Error receiving public key or invalid key size.");
     }
+    std::memcpy(verificationKey, record, XMSS_KEY_LEN);
 
     print_hex("[XMSS] Recipient verification key", verificationKey, XMSS_KEY_LEN);
 }
 
-// подпись и отправка сообщения
-void sendSignedKey(int socket, const uint8_t* key, XMSS &xmss) {
-
-    std::vector<uint8_t> signature = xmss.getSignature(std::vector<uint8_t>(key, key + CURVE25519_KEY_LEN));
-    uint32_t sigLen = htonl(static_cast<uint32_t>(signature.size()));
+// подпись и отправка сообщения: подпись пишется сразу в кадр отправки за ключом
+void sendSignedKey(int socket, const uint8_t* key, XMSSIdentity &xmss) {
 
-    std::vector<uint8_t> buffer;
-    buffer.insert(buffer.end(), key, key + CURVE25519_KEY_LEN);
-    buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&sigLen), reinterpret_cast<uint8_t*>(&sigLen) + sizeof(sigLen)); // Добавляем длину подписи
-    buffer.insert(buffer.end(), signature.begin(), signature.end());
+    char frame[RecordReader::HEADER_LEN + SIGNED_KEY_LEN];
+    uint8_t* body = reinterpret_cast<uint8_t*>(frame + RecordReader::HEADER_LEN);
+    std::memcpy(body, key, CURVE25519_KEY_LEN);
+    xmss.signInto(Span<const uint8_t>(key, CURVE25519_KEY_LEN),
+                  Span<uint8_t>(body + CURVE25519_KEY_LEN, XMSSIdentity::SIGNATURE_BYTES));
 
     print_hex("[Curve25519] Our public key", key, CURVE25519_KEY_LEN);
 
-    size_t bytesSent = send(socket, buffer.data(), buffer.size(), 0);
-    if (bytesSent != buffer.size()) {
+    if (!sendRecord(socket, frame, SIGNED_KEY_LEN)) {
         throw std::runtime_error("Error sending signed key.");
     }
 
 }
 
-// получение и валидация сообщения
-bool receiveSignedKey(int socket, uint8_t* senderPublicKey, uint8_t* senderVerifyKey, int* returnCode) {
-    const size_t bufferSize = BUFFER_SIZE;
-
-    char* buffer = new char[bufferSize];
+// получение и валидация сообщения: подпись разбирается и проверяется прямо в кольце приема
+bool receiveSignedKey(RecordReader& reader, uint8_t* senderPublicKey, uint8_t* senderVerifyKey, int* returnCode) {
+    char* record = nullptr;
+    size_t length = 0;
 
-    // Принимаем данные
-    ssize_t bytesRead = recv(socket, buffer, bufferSize, 0);
-    if (bytesRead <= 0) {
-        delete[] buffer;
-        *returnCode = (bytesRead == 0) ? 2 : 1; // 2 - закрыто, 1 - ошибка чтения
+    RecordReader::Status status = reader.next(&record, &length);
+    if (status == RecordReader::CLOSED || status == RecordReader::FAILED) {
+        *returnCode = (status == RecordReader::CLOSED) ? 2 : 1; // 2 - закрыто, 1 - ошибка чтения
         return false;
     }
 
-    // Проверяем, что сообщение содержит ключ фиксированной длины
-    if (bytesRead <= CURVE25519_KEY_LEN + sizeof(uint32_t)) {
-        delete[] buffer;
+    // Проверяем длину, версию формата и параметры подписи
+    if (status != RecordReader::RECORD || length != SIGNED_KEY_LEN) {
         *returnCode = 4; // Неверный формат данных
         return false;
     }
-
-    // Извлекаем публичный ключ отправителя
-    std::memcpy(senderPublicKey, buffer, CURVE25519_KEY_LEN);
-
-    // Извлекаем длину подписи
-    uint32_t sigLen = ntohl(*reinterpret_cast<uint32_t*>(buffer + CURVE25519_KEY_LEN));
-
-    // Проверяем, что оставшихся данных достаточно для подписи
-    if (bytesRead < CURVE25519_KEY_LEN + sizeof(uint32_t) + sigLen) {
-        delete[] buffer;
-        *returnCode = 4; // Неверный формат данных
+    const uint8_t* buffer = reinterpret_cast<const uint8_t*>(record);
+    XMSSIdentity::SignatureView signature(Span<const uint8_t>(buffer + CURVE25519_KEY_LEN, XMSSIdentity::SIGNATURE_BYTES));
+    if (!signature.valid()) {
+        *returnCode = 4;
         return false;
     }
 
-    std::vector<uint8_t> signature(buffer + CURVE25519_KEY_LEN + sizeof(uint32_t), buffer + CURVE25519_KEY_LEN + sizeof(uint32_t) + sigLen);
-
-    std::vector<uint8_t> messageVec(senderPublicKey, senderPublicKey + CURVE25519_KEY_LEN);
-    std::vector<uint8_t> senderVerifyKeyVec(senderVerifyKey, senderVerifyKey + XMSS_KEY_LEN);
-
-    bool isValid = XMSS::Verify(messageVec, signature, senderVerifyKeyVec);
+    bool isValid = XMSSIdentity::Verify(Span<const uint8_t>(buffer, CURVE25519_KEY_LEN), signature,
+                                        Span<const uint8_t>(senderVerifyKey, XMSS_KEY_LEN));
     if (!isValid) {
-        delete[] buffer;
         *returnCode = 3; // Неверная подпись
         return false;
     }
 
+    // Публичный ключ отправителя отдаем только после проверки подписи
+    std::memcpy(senderPublicKey, buffer, CURVE25519_KEY_LEN);
     print_hex("[Curve25519] Recipient public key (verified)", senderPublicKey, CURVE25519_KEY_LEN);
 
-    delete[] buffer;
     return true;
 }
 
-// генерация nonce для #ChaCha20 используя таймстемп
-void getTimestampNonce(uint8_t* nonce) {
-
-    size_t size = CHACHA20_NONCE_LEN;
-
-    uint64_t timestamp = static_cast<uint64_t>(std::time(nullptr)); // 8 байт
-    std::memcpy(nonce, &timestamp, std::min(size, sizeof(timestamp)));
-    if (size > sizeof(timestamp)) {
-        std::memset(nonce + sizeof(timestamp), 0, size - sizeof(timestamp));
-    }
-
-    // print_hex("[ChaCha20] Session nonce", nonce, size);
-}
-
 // генерация ключа для #ChaCha20 из хеша #Keccak
 void getSharedSecretHash(uint8_t* out, const uint8_t* msg) {
 
     size_t msgLen = CHACHA20_KEY_LEN;
 
-    std::vector<unsigned char> msgVector(msg, msg + msgLen);
-    std::vector<unsigned char> resultVector = keccak(msgVector, msgLen);
+    KeccakSponge::hash(Span<const uint8_t>(msg, msgLen), Span<uint8_t>(out, msgLen));
 
-    std::copy(resultVector.begin(), resultVector.end(), out);
+    print_hex("[ChaCha20] Session key", out, msgLen);
+}
 
-    print_hex("[ChaCha20] Session key", resultVector.data(), msgLen);
+// сборка записи из нескольких кусков открытого текста прямо в буфер отправки, без промежуточных копий
+size_t chacha20SealGather(char* record, const struct iovec* parts, size_t count, KeystreamReservoir& reservoir) {
+    return reservoir.seal_record(reinterpret_cast<uint8_t*>(record), parts, count);
 }
 
-// обертка для шифрования и дешифрования сообщений с #ChaCha20
-void chacha20Wrapper(char* out, const char* in, size_t msgLength, const uint8_t* key, bool decrypt = false) {
-    uint8_t nonce[CHACHA20_NONCE_LEN];
-    const uint8_t* inputData;
+// nonce записи номер sequence стороны с префиксом prefix: 4 байта префикса | 8 байт номера (little-endian),
+// та же раскладка, что у исходящих записей KeystreamReservoir
+void getSequenceNonce(uint8_t* nonce, uint32_t prefix, uint64_t sequence) {
+    for (int i = 0; i < 4; ++i) {
+        nonce[i] = static_cast<uint8_t>(prefix >> (8 * i));
+    }
+    for (int i = 0; i < 8; ++i) {
+        nonce[4 + i] = static_cast<uint8_t>(sequence >> (8 * i));
+    }
+}
 
-    if (decrypt) {
-        memcpy(nonce, in, CHACHA20_NONCE_LEN);
-        inputData = reinterpret_cast<const uint8_t*>(in + CHACHA20_NONCE_LEN);
-        msgLength -= CHACHA20_NONCE_LEN;
-    } else {
-        getTimestampNonce(nonce);
-        inputData = reinterpret_cast<const uint8_t*>(in);
+// формат записи #ChaCha20-Poly1305: nonce | шифртекст | тег Poly1305 (CHACHA20_TAG_LEN байт)
+// дешифрование записи на месте: при успехе открытый текст лежит в record + CHACHA20_NONCE_LEN,
+// его длина записывается в msgLength; при неверном теге возвращает false.
+// Nonce не берется на веру: принимается только префикс собеседника peerPrefix с номером *sequence,
+// так что повтор старой записи или отраженная запись другой стороны отвергаются.
+// Номер увеличивается только после проверки тега.
+bool chacha20OpenInPlace(char* record, size_t recordLength, const uint8_t* key, uint32_t peerPrefix,
+                         uint64_t* sequence, size_t* msgLength) {
+    if (recordLength < CHACHA20_NONCE_LEN + CHACHA20_TAG_LEN) {
+        return false;
     }
 
-    uint8_t* outputLocation = decrypt ? reinterpret_cast<uint8_t*>(out) : reinterpret_cast<uint8_t*>(out + CHACHA20_NONCE_LEN);
-    ChaCha20::encrypt(outputLocation, key, nonce, inputData, msgLength);
+    uint8_t nonce[CHACHA20_NONCE_LEN];
+    getSequenceNonce(nonce, peerPrefix, *sequence);
+    if (std::memcmp(nonce, record, CHACHA20_NONCE_LEN) != 0) {
+        return false;
+    }
+
+    uint8_t* payload = reinterpret_cast<uint8_t*>(record) + CHACHA20_NONCE_LEN;
+    size_t payloadLength = recordLength - CHACHA20_NONCE_LEN - CHACHA20_TAG_LEN;
 
-    if (!decrypt) {
-        memcpy(out, nonce, CHACHA20_NONCE_LEN);
-        // std::cout << "[ChaCha20] Ciphertext" << out << std::endl;
+    if (!ChaCha20Poly1305::open(payload, key, nonce, nullptr, 0, payload, payloadLength, payload + payloadLength)) {
+        return false;
     }
+    ++*sequence;
+    *msgLength = payloadLength;
+    return true;
 }
\ No newline at end of file
@@ -4,9 +4,22 @@
 #define PORT 8000
 
 #define XMSS_KEY_LEN 32
+#define XMSS_TREE_HEIGHT 10 // 2^10 одноразовых подписей на ключ
+#define XMSS_WINTERNITZ 16 // длина цепочек WOTS: 4, 16 или 256 (хэш - XMSS_KEY_LEN * 8 бит)
+#define SERVER_XMSS_KEY_FILE "server.xmsskey" // постоянные ключи XMSS сторон
+#define CLIENT_XMSS_KEY_FILE "client.xmsskey"
 #define CURVE25519_KEY_LEN 32
 #define CHACHA20_KEY_LEN 32
 #define CHACHA20_NONCE_LEN 12
+#define CHACHA20_TAG_LEN 16
+
+// записи на соединении: 4 байта длины | nonce | шифртекст | тег
+#define RECORD_BUFFER_SIZE 65536 // кольцо приема на соединение, ограничивает длину записи
+#define MAX_MESSAGE_LEN 60000 // сообщение пользователя с запасом под nonce, тег и обрамление ответа
+
+// префиксы nonce исходящих записей, у каждой стороны свой
+#define SERVER_NONCE_PREFIX 0x53525652 // "RVRS"
+#define CLIENT_NONCE_PREFIX 0x544e4c43 // "CLNT"
 
 #include <iostream>
 #include <iomanip>
@@ -18,7 +31,11 @@
 #include <sys/socket.h>
 
 #include "XMSS/XMSS.h" // Подпись XMSS
+#include "XMSS/xmss_mt.h" // XMSS^MT из нескольких слоев деревьев
 #include "CURVE25519/curve25519.h"
 #include "CHACHA20/chacha20.h"
+#include "CHACHA20/chacha20poly1305.h"
+#include "CHACHA20/keystream_reservoir.h"
+#include "FRAMING/record_reader.h"
 
 #include "handling.h"
\ No newline at end of file
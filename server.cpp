@@ -53,10 +53,12 @@ int main() {
     std::cout << "Client trying to connect from " << clientIP << "\n";
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nExchanging XMSS public keys with client...\n\n";
 
-    XMSS xmss = createNewXMSSObject(); // создаем объект #XMSS который содержит наш ключ и подпись
+    XMSSIdentity xmss = loadXMSSIdentity(SERVER_XMSS_KEY_FILE); // загружаем (или создаем) постоянный ключ #XMSS
+
+    RecordReader reader(clientSocket, RECORD_BUFFER_SIZE); // все входящие записи соединения идут через одно кольцо приема
 
     uint8_t clientVerifyKey[32];
-    receiveVerificationKey(clientSocket, clientVerifyKey);
+    receiveVerificationKey(reader, clientVerifyKey);
     sendVerificationKey(clientSocket, xmss);
 
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nInitializing XMSS-Curve25519 handshake...\n\n";
@@ -68,7 +70,7 @@ int main() {
 
     int result = 0;
     uint8_t alicePublic[32];
-    bool recieved = receiveSignedKey(clientSocket, alicePublic, clientVerifyKey, &result);  // получаем (и проверяем) подписанный #XMSS ключ клиента
+    bool recieved = receiveSignedKey(reader, alicePublic, clientVerifyKey, &result);  // получаем (и проверяем) подписанный #XMSS ключ клиента
 
     if(!recieved) {
         std::cout << "Could not verify signature! Error code: " << result << std::endl;
@@ -81,52 +83,68 @@ int main() {
 
     uint8_t chachaKey[32], chachaNonce[12];
     getSharedSecretHash(chachaKey, shared); // вычисляем симметричный ключ #CHACHA20 из хэша #KECCAK
+    KeystreamReservoir reservoir(chachaKey, SERVER_NONCE_PREFIX); // заранее готовим ключевой поток для ответов
+    uint64_t receiveSequence = 0; // номер следующей ожидаемой записи клиента
 
     std::cout << "\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n" << "\nClient successfully connected!" << std::endl;
     
-    char buffer[BUFFER_SIZE];
+    static char response[RecordReader::HEADER_LEN + RECORD_BUFFER_SIZE]; // кадр ответа: длина | nonce | префикс + сообщение + суффикс | тег
     while (true) {
 
         // ПРИЕМ СООБЩЕНИЯ ОТ КЛИЕНТА
 
-        memset(buffer, 0, sizeof(buffer));  // Очистка буфера
-        ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
-        if (bytesRead < 0) {
+        char* record = nullptr;
+        size_t recordLength = 0;
+        RecordReader::Status status = reader.next(&record, &recordLength); // целая запись прямо в кольце приема
+        if (status == RecordReader::FAILED) {
             std::cerr << "Error: Unable to read from client.\n";
             break;
         }
-        if (bytesRead == 0) {
+        if (status == RecordReader::CLOSED) {
             std::cout << "Client disconnected. Shutting down server.\n";
             break;
         }
+        if (status == RecordReader::OVERSIZED) {
+            std::cerr << "Error: Client record is too large.\n";
+            break;
+        }
 
-        if (bytesRead <= CHACHA20_NONCE_LEN) {
+        if (recordLength <= CHACHA20_NONCE_LEN + CHACHA20_TAG_LEN) {
             std::cerr << "Error: Message too short to contain valid data.\n";
             continue;
         }
 
-        // print_hex("Received", reinterpret_cast<const uint8_t*>(buffer), bytesRead);
+        // print_hex("Received", reinterpret_cast<const uint8_t*>(record), recordLength);
 
-        size_t msgLength = bytesRead - CHACHA20_NONCE_LEN;
-        char* message = new char[msgLength];
-        chacha20Wrapper(message, buffer, bytesRead, chachaKey, true); // дешифруем сообщение #CHACHA20
-        std::string messageString(message, msgLength);
-
-        delete[] message;
+        size_t msgLength = 0;
+        if (!chacha20OpenInPlace(record, recordLength, chachaKey, CLIENT_NONCE_PREFIX, &receiveSequence, &msgLength)) { // дешифруем сообщение #CHACHA20 на месте и проверяем тег
+            std::cerr << "Error: Message authentication failed.\n";
+            continue;
+        }
+        const char* message = record + CHACHA20_NONCE_LEN;
 
         // ОТВЕТ КЛИЕНТУ
 
-        std::string responseString = "Recieved message: \"" + messageString + "\"\n";
-        // std::cout << responseString << std::endl;
-        size_t responseLength = responseString.size();
-        size_t encryptedLength = responseLength + CHACHA20_NONCE_LEN;
-        char* response = new char[encryptedLength];
+        if (msgLength > MAX_MESSAGE_LEN) {
+            std::cerr << "Error: Message is too large to answer.\n";
+            continue;
+        }
 
-        chacha20Wrapper(response, responseString.c_str(), responseLength, chachaKey, false); // шифруем сообщение #CHACHA20
+        // ответ собирается из кусков сразу в кадр отправки, без промежуточных строк
+        static const char responsePrefix[] = "Recieved message: \"";
+        static const char responseSuffix[] = "\"\n";
+        struct iovec parts[3] = {
+            { const_cast<char*>(responsePrefix), sizeof(responsePrefix) - 1 },
+            { const_cast<char*>(message), msgLength },
+            { const_cast<char*>(responseSuffix), sizeof(responseSuffix) - 1 }
+        };
 
-        send(clientSocket, response, encryptedLength, 0);
+        size_t encryptedLength = chacha20SealGather(response + RecordReader::HEADER_LEN, parts, 3, reservoir); // шифруем сообщение #CHACHA20
 
-        delete[] response;
+        if (!sendRecord(clientSocket, response, encryptedLength)) {
+            std::cerr << "Error: Unable to send response.\n";
+            break;
+        }
     }
 
     close(clientSocket);